@@ -0,0 +1,203 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "binding.h"
+#include "gesture.h"
+#include "log.h"
+
+#include "fake-command.h"
+
+#define BENCH_GESTURES		20000
+#define BENCH_MAX_EVENTS	512
+/* length of a synthetic swipe, in libinput delta units */
+#define BENCH_SWIPE_DIST	400.0
+
+/* allocations are counted with -Wl,--wrap */
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static unsigned long allocations;
+
+void *__wrap_malloc(size_t size)
+{
+	allocations++;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+	allocations++;
+	return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	allocations++;
+	return __real_realloc(ptr, size);
+}
+
+struct stream {
+	int nfingers;
+	/* number of UPDATE events */
+	int length;
+	/* degrees, 0 is right, 90 is down as libinput deltas go */
+	double angle;
+	/* per event jitter relative to the step */
+	double noise;
+};
+
+static const struct stream streams[] = {
+	{ 3,  10,   0, 0.0 },
+	{ 3,  50,   0, 0.0 },
+	{ 3, 200,   0, 0.0 },
+	{ 3,  50,  90, 0.0 },
+	{ 3,  50, 180, 0.0 },
+	{ 3,  50, 270, 0.0 },
+	{ 3,  50,  20, 0.0 },
+	{ 3,  50,  45, 0.0 },
+	{ 3,  50,   0, 0.5 },
+	{ 3,  50,  30, 1.0 },
+	{ 4,  50,   0, 0.0 },
+	{ 5,  50,   0, 0.5 },
+};
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ull;
+
+/* xorshift64*, streams are the same on every run */
+static double rng_uniform(void)
+{
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return (double)((rng_state * 0x2545f4914f6cdd1dull) >> 11) /
+	       (double)(1ull << 53) * 2.0 - 1.0;
+}
+
+static int stream_build(const struct stream *stream,
+			struct gesture_event *events)
+{
+	double step = BENCH_SWIPE_DIST / stream->length;
+	double rad = stream->angle * M_PI / 180.0;
+	uint64_t time_usec = 0;
+	int i, n = 0;
+
+	memset(events, 0, sizeof(*events) * (stream->length + 2));
+
+	events[n].type = GESTURE_SWIPE;
+	events[n].phase = GESTURE_BEGIN;
+	events[n].nfingers = stream->nfingers;
+	events[n++].time_usec = time_usec;
+
+	for (i = 0; i < stream->length; i++) {
+		time_usec += 7000;
+		events[n].type = GESTURE_SWIPE;
+		events[n].phase = GESTURE_UPDATE;
+		events[n].nfingers = stream->nfingers;
+		events[n].time_usec = time_usec;
+		events[n].dx = step * (cos(rad) + stream->noise * rng_uniform());
+		events[n].dy = step * (sin(rad) + stream->noise * rng_uniform());
+		events[n].dx_unaccel = events[n].dx;
+		events[n].dy_unaccel = events[n].dy;
+		n++;
+	}
+
+	events[n].type = GESTURE_SWIPE;
+	events[n].phase = GESTURE_END;
+	events[n].nfingers = stream->nfingers;
+	events[n++].time_usec = time_usec;
+
+	return n;
+}
+
+static uint64_t clock_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* returns the number of allocations made by the recognizers */
+static unsigned long bench_stream(const struct stream *stream, int gestures)
+{
+	static struct gesture_event events[BENCH_MAX_EVENTS];
+	struct gesture *gest = NULL;
+	unsigned long allocs, actions;
+	uint64_t start_nsec, elapsed_nsec;
+	int i, j, n;
+
+	n = stream_build(stream, events);
+
+	allocs = allocations;
+	actions = fake_command_count();
+	start_nsec = clock_nsec();
+
+	for (i = 0; i < gestures; i++)
+		for (j = 0; j < n; j++)
+			gesture_dispatch(&gest, &events[j]);
+
+	elapsed_nsec = clock_nsec() - start_nsec;
+	allocs = allocations - allocs;
+	actions = fake_command_count() - actions;
+
+	printf("%7d %6d %5.0f %5.1f | %8.1f %10.0f %12.3f %9.3f\n",
+	       stream->nfingers, stream->length, stream->angle, stream->noise,
+	       (double)elapsed_nsec / ((uint64_t)gestures * n),
+	       gestures * 1e9 / elapsed_nsec,
+	       (double)allocs / gestures,
+	       (double)actions / gestures);
+
+	return allocs;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bindings *bindings;
+	unsigned long allocs = 0;
+	int gestures = BENCH_GESTURES;
+	size_t i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:")) != -1) {
+		switch (opt) {
+		case 'n':
+			gestures = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-n gestures]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* recognizers only, logging has its own cost */
+	openlog("swayped-bench", LOG_PERROR, LOG_USER);
+	log_set_level(LOG_ERR);
+
+	bindings = bindings_load(NULL);
+	if (!bindings)
+		return EXIT_FAILURE;
+	bindings_set(bindings);
+
+	printf("fingers length angle noise | ns/event gestures/s allocs/gesture "
+	       "actions\n");
+	for (i = 0; i < sizeof(streams) / sizeof(streams[0]); i++)
+		allocs += bench_stream(&streams[i], gestures);
+
+	bindings_set(NULL);
+	bindings_destroy(bindings);
+
+	/* gesture processing must never allocate, see GESTURE_POOL_SIZE */
+	if (allocs) {
+		printf("%lu allocations while processing gestures\n", allocs);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,144 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "binding.h"
+#include "sector.h"
+
+/*
+ * Checks the fixed point sector classifier against atan2() over the whole
+ * angle range for every diagonal width, then times it unless -c is given.
+ */
+
+/* angle steps per degree */
+#define CHECK_STEPS		100
+/* samples closer than that to a boundary may go either way */
+#define CHECK_EPSILON		0.01
+#define CHECK_RADIUS		150.0
+#define BENCH_LOOPS		100
+
+static double deg(double rad)
+{
+	return rad * 180 / M_PI;
+}
+
+static int quadrant(int up_down, double dx, double dy)
+{
+	if (up_down == 0)
+		return dx > 0 ? BINDING_RIGHT : BINDING_LEFT;
+	if (up_down == 1)
+		return dy > 0 ? BINDING_DOWN : BINDING_UP;
+	if (dy > 0)
+		return dx > 0 ? BINDING_DOWN_RIGHT : BINDING_DOWN_LEFT;
+	return dx > 0 ? BINDING_UP_RIGHT : BINDING_UP_LEFT;
+}
+
+/* -2 when too close to a boundary to tell */
+static int reference(double width, double dx, double dy, bool strict)
+{
+	double cardinal = 90 - width;
+	/* from the x axis, folded in the first quadrant */
+	double a = deg(atan2(fabs(dy), fabs(dx)));
+	const double bounds[] = {
+		cardinal / 2, 90 - cardinal / 2,
+		cardinal / 4, 90 - cardinal / 4,
+		45 - width / 4, 45 + width / 4,
+	};
+	unsigned int i;
+
+	for (i = 0; i < sizeof(bounds) / sizeof(bounds[0]); i++)
+		if (fabs(a - bounds[i]) < CHECK_EPSILON)
+			return -2;
+
+	if (a <= cardinal / 2)
+		return !strict || a <= cardinal / 4 ? quadrant(0, dx, dy) : -1;
+	if (a >= 90 - cardinal / 2)
+		return !strict || a >= 90 - cardinal / 4 ?
+		       quadrant(1, dx, dy) : -1;
+	if (strict && (width == 0 || fabs(a - 45) > width / 4))
+		return -1;
+	return quadrant(2, dx, dy);
+}
+
+static uint64_t clock_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long checked = 0, skipped = 0, mismatches = 0;
+	struct sectors sectors;
+	double width, a, dx, dy;
+	uint64_t start_nsec, elapsed_nsec;
+	volatile int sink = 0;
+	int step, strict, expected, got, loop, opt;
+	bool check_only = false;
+
+	while ((opt = getopt(argc, argv, "c")) != -1) {
+		switch (opt) {
+		case 'c':
+			check_only = true;
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-c]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (width = 0; width <= 90; width += 0.5) {
+		sectors_init(&sectors, width);
+
+		for (step = 0; step < 360 * CHECK_STEPS; step++) {
+			a = (double)step / CHECK_STEPS * M_PI / 180;
+			dx = CHECK_RADIUS * cos(a);
+			dy = CHECK_RADIUS * sin(a);
+
+			for (strict = 0; strict < 2; strict++) {
+				expected = reference(width, dx, dy, strict);
+				if (expected == -2) {
+					skipped++;
+					continue;
+				}
+
+				checked++;
+				got = sectors_classify(&sectors, dx, dy, strict);
+				if (got == expected)
+					continue;
+
+				if (mismatches++ < 10)
+					printf("width %.1f angle %.2f%s: "
+					       "expected %d got %d\n", width,
+					       (double)step / CHECK_STEPS,
+					       strict ? " strict" : "",
+					       expected, got);
+			}
+		}
+	}
+
+	printf("%lu checked, %lu near a boundary, %lu mismatches\n",
+	       checked, skipped, mismatches);
+	if (check_only)
+		goto exit;
+
+	sectors_init(&sectors, BINDING_DIAGONAL_WIDTH);
+	start_nsec = clock_nsec();
+	for (loop = 0; loop < BENCH_LOOPS; loop++) {
+		for (step = 0; step < 360 * CHECK_STEPS; step++) {
+			dx = step % 720 - 360;
+			dy = step / 100 - 180;
+			sink += sectors_classify(&sectors, dx, dy, step & 1);
+		}
+	}
+	elapsed_nsec = clock_nsec() - start_nsec;
+
+	printf("%.2f ns/classify\n",
+	       (double)elapsed_nsec / (BENCH_LOOPS * 360 * CHECK_STEPS));
+exit:
+	return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,350 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wordexp.h>
+
+#include <ini.h>
+
+#include "binding.h"
+#include "log.h"
+
+/*
+ * Matches the behaviour swayped had before bindings were configurable.
+ * Continuous actions are only bound from a configuration file, e.g. a
+ * 4 finger pinch changing the opacity of the focused window:
+ *
+ *	[pinch]
+ *	4_increase = opacity plus %.2f
+ *	4_decrease = opacity minus %.2f
+ *	4_scale = 0.5
+ *	4_step = 0.01
+ */
+static const char default_config[] =
+	"[swipe]\n"
+	"3_up = new_workspace\n"
+	"3_down = workspace back_and_forth\n"
+	"3_left = workspace prev\n"
+	"3_right = workspace next\n";
+
+static const char * const gesture_type_str[] = {
+	[GESTURE_HOLD]  = "hold",
+	[GESTURE_PINCH] = "pinch",
+	[GESTURE_SWIPE] = "swipe",
+};
+
+static const char * const direction_str[] = {
+	[BINDING_UP]          = "up",
+	[BINDING_DOWN]        = "down",
+	[BINDING_LEFT]        = "left",
+	[BINDING_RIGHT]       = "right",
+	[BINDING_UP_LEFT]     = "up_left",
+	[BINDING_UP_RIGHT]    = "up_right",
+	[BINDING_DOWN_LEFT]   = "down_left",
+	[BINDING_DOWN_RIGHT]  = "down_right",
+	[BINDING_CIRCLE_CW]   = "circle_cw",
+	[BINDING_CIRCLE_CCW]  = "circle_ccw",
+	[BINDING_SHAPE_L]     = "l",
+	[BINDING_SHAPE_Z]     = "z",
+	[BINDING_SHAPE_V]     = "v",
+	[BINDING_SHAPE_CARET] = "caret",
+	[BINDING_IN]          = "in",
+	[BINDING_OUT]         = "out",
+};
+
+/* sway commands the command layer knows how to coalesce */
+static const struct {
+	const char *str;
+	enum action_type type;
+} builtin_actions[] = {
+	{ "workspace next",           ACTION_WORKSPACE_NEXT },
+	{ "workspace prev",           ACTION_WORKSPACE_PREV },
+	{ "workspace back_and_forth", ACTION_WORKSPACE_BACK_AND_FORTH },
+	{ "new_workspace",            ACTION_WORKSPACE_NEW },
+	{ "new_workspace lowest",     ACTION_WORKSPACE_NEW_LOWEST },
+};
+
+static struct bindings *current;
+
+static int parse_bool(const char *value, bool *out)
+{
+	if (!strcmp(value, "true") || !strcmp(value, "yes") ||
+	    !strcmp(value, "1")) {
+		*out = true;
+		return 1;
+	}
+
+	if (!strcmp(value, "false") || !strcmp(value, "no") ||
+	    !strcmp(value, "0")) {
+		*out = false;
+		return 1;
+	}
+
+	return 0;
+}
+
+static int parse_double(const char *value, double *out)
+{
+	char *end;
+
+	*out = strtod(value, &end);
+	return end != value && !*end;
+}
+
+static int parse_diagonal_width(const char *value, struct sectors *sectors)
+{
+	double width;
+
+	if (!parse_double(value, &width) || width < 0 || width > 90) {
+		log_err("Invalid diagonal width '%s', expect 0 to 90\n",
+			value);
+		return 0;
+	}
+
+	sectors_init(sectors, width);
+	return 1;
+}
+
+/* "spawn <command line>" runs a program without going through sway */
+static int parse_spawn(const char *value, struct action *action)
+{
+	size_t len = 0, word_len;
+	wordexp_t words;
+	unsigned int i;
+	int ret;
+
+	/* no command substitution, the file is only parsed here */
+	ret = wordexp(value, &words, WRDE_NOCMD);
+	if (ret != 0) {
+		log_err("Invalid spawn command line: %s\n", value);
+		return 0;
+	}
+
+	ret = 0;
+	if (words.we_wordc == 0) {
+		log_err("Nothing to spawn\n");
+		goto exit;
+	}
+
+	for (i = 0; i < words.we_wordc; i++) {
+		word_len = strlen(words.we_wordv[i]) + 1;
+		if (len + word_len > sizeof(action->command)) {
+			log_err("Command too long: %s\n", value);
+			goto exit;
+		}
+		memcpy(action->command + len, words.we_wordv[i], word_len);
+		len += word_len;
+	}
+
+	action->type = ACTION_SPAWN;
+	action->argc = words.we_wordc;
+	ret = 1;
+exit:
+	wordfree(&words);
+	return ret;
+}
+
+static int parse_action(const char *value, struct action *action)
+{
+	size_t i;
+
+	if (!strncmp(value, "spawn ", strlen("spawn ")))
+		return parse_spawn(value + strlen("spawn "), action);
+
+	for (i = 0; i < sizeof(builtin_actions) / sizeof(builtin_actions[0]);
+	     i++) {
+		if (!strcmp(value, builtin_actions[i].str)) {
+			action->type = builtin_actions[i].type;
+			return 1;
+		}
+	}
+
+	if (strlen(value) >= sizeof(action->command)) {
+		log_err("Command too long: %s\n", value);
+		return 0;
+	}
+
+	action->type = ACTION_COMMAND;
+	strcpy(action->command, value);
+	return 1;
+}
+
+/* "increase", "decrease", "scale" and "step" describe a continuous action */
+static int parse_continuous(const char *name, const char *value,
+			    struct action *action)
+{
+	struct continuous_action *continuous = &action->continuous;
+
+	if (strcmp(name, "increase") && strcmp(name, "decrease") &&
+	    strcmp(name, "scale") && strcmp(name, "step")) {
+		log_err("Unknown continuous action key '%s'\n", name);
+		return 0;
+	}
+
+	if (action->type != ACTION_CONTINUOUS) {
+		action->type = ACTION_CONTINUOUS;
+		continuous->scale = 1.0;
+		continuous->min_step = BINDING_CONTINUOUS_STEP;
+	}
+
+	if (!strcmp(name, "increase") || !strcmp(name, "decrease")) {
+		if (!throttle_format_valid(value)) {
+			log_err("Invalid continuous command '%s', "
+				"expect a single %%f conversion\n", value);
+			return 0;
+		}
+		strcpy(name[0] == 'i' ? continuous->increase :
+					continuous->decrease, value);
+		return 1;
+	}
+
+	if (!strcmp(name, "scale"))
+		return parse_double(value, &continuous->scale);
+
+	/* a zero step would send zero amounts */
+	if (!strcmp(name, "step")) {
+		if (!parse_double(value, &continuous->min_step) ||
+		    continuous->min_step <= 0) {
+			log_err("Invalid step '%s', expect a positive amount\n",
+				value);
+			return 0;
+		}
+		return 1;
+	}
+
+	return 0;
+}
+
+static int bindings_handler(void *user, const char *section,
+			    const char *name, const char *value)
+{
+	struct bindings *bindings = user;
+	enum gesture_type type;
+	long nfingers;
+	char *dir;
+	int i;
+
+	if (!strcmp(section, "general")) {
+		if (!strcmp(name, "early_commit"))
+			return parse_bool(value, &bindings->early_commit);
+		goto error;
+	}
+
+	for (type = 0; type < GESTURE_TYPE_COUNT; type++)
+		if (!strcmp(section, gesture_type_str[type]))
+			break;
+	if (type == GESTURE_TYPE_COUNT)
+		goto error;
+
+	if (type == GESTURE_SWIPE && !strcmp(name, "diagonal_width"))
+		return parse_diagonal_width(value, &bindings->sectors);
+
+	/* keys are <fingers>_<direction> */
+	nfingers = strtol(name, &dir, 10);
+	if (dir == name || *dir != '_' || nfingers < 1 ||
+	    nfingers > BINDING_FINGERS_MAX)
+		goto error;
+	dir++;
+
+	for (i = 0; i < BINDING_CONTINUOUS; i++)
+		if (direction_str[i] && !strcmp(dir, direction_str[i]))
+			return parse_action(value,
+					&bindings->actions[type][nfingers][i]);
+
+	return parse_continuous(dir, value, &bindings->actions[type][nfingers]
+							    [BINDING_CONTINUOUS]);
+
+error:
+	log_err("Unknown configuration key [%s] %s\n", section, name);
+	return 0;
+}
+
+struct bindings *bindings_load(const char *path)
+{
+	struct bindings *bindings;
+	int nfingers, i;
+	int ret;
+
+	bindings = calloc(1, sizeof(*bindings));
+	if (!bindings)
+		return NULL;
+	sectors_init(&bindings->sectors, BINDING_DIAGONAL_WIDTH);
+
+	if (path)
+		ret = ini_parse(path, bindings_handler, bindings);
+	else
+		ret = ini_parse_string(default_config, bindings_handler,
+				       bindings);
+
+	if (ret != 0) {
+		if (ret < 0)
+			log_err("Failed to read %s\n", path);
+		else
+			log_err("%s:%d: invalid configuration\n",
+				path ? path : "defaults", ret);
+		bindings_destroy(bindings);
+		return NULL;
+	}
+
+	for (nfingers = 0; nfingers <= BINDING_FINGERS_MAX; nfingers++)
+		for (i = BINDING_CIRCLE_CW; i <= BINDING_SHAPE_CARET; i++)
+			if (bindings->actions[GESTURE_SWIPE][nfingers][i].type !=
+			    ACTION_NONE)
+				bindings->shapes[nfingers] = true;
+
+	log_info("Bindings loaded from %s\n", path ? path : "defaults");
+	return bindings;
+}
+
+void bindings_destroy(struct bindings *bindings)
+{
+	free(bindings);
+}
+
+const char *bindings_default_path(void)
+{
+	static char path[PATH_MAX];
+	const char *dir = getenv("XDG_CONFIG_HOME");
+	const char *home = getenv("HOME");
+	int ret;
+
+	if (dir && dir[0])
+		ret = snprintf(path, sizeof(path), "%s/swayped/config", dir);
+	else if (home)
+		ret = snprintf(path, sizeof(path), "%s/.config/swayped/config",
+			       home);
+	else
+		return NULL;
+
+	return ret > 0 && (size_t)ret < sizeof(path) ? path : NULL;
+}
+
+void bindings_set(struct bindings *bindings)
+{
+	current = bindings;
+}
+
+struct bindings *bindings_get(void)
+{
+	return current;
+}
+
+bool binding_has_shapes(int nfingers)
+{
+	if (!current || nfingers < 0 || nfingers > BINDING_FINGERS_MAX)
+		return false;
+
+	return current->shapes[nfingers];
+}
+
+const struct action *binding_lookup(enum gesture_type type, int nfingers,
+				    enum binding_direction direction)
+{
+	const struct action *action;
+
+	if (!current || nfingers < 0 || nfingers > BINDING_FINGERS_MAX)
+		return NULL;
+
+	action = &current->actions[type][nfingers][direction];
+	return action->type != ACTION_NONE ? action : NULL;
+}
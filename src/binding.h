@@ -0,0 +1,95 @@
+#ifndef _BINDING_H_
+#define _BINDING_H_
+
+#include <stdbool.h>
+
+#include "gesture.h"
+#include "sector.h"
+#include "throttle.h"
+
+#define BINDING_FINGERS_MAX	5
+#define BINDING_COMMAND_SIZE	256
+/* degrees, diagonals only take the former dead zone between axes */
+#define BINDING_DIAGONAL_WIDTH	12.0
+/* smallest amount a continuous action sends, unless set with N_step */
+#define BINDING_CONTINUOUS_STEP	0.01
+
+enum binding_direction {
+	BINDING_UP,
+	BINDING_DOWN,
+	BINDING_LEFT,
+	BINDING_RIGHT,
+	BINDING_UP_LEFT,
+	BINDING_UP_RIGHT,
+	BINDING_DOWN_LEFT,
+	BINDING_DOWN_RIGHT,
+	/* swipe strokes matched against templates, see shape.c */
+	BINDING_CIRCLE_CW,
+	BINDING_CIRCLE_CCW,
+	BINDING_SHAPE_L,
+	BINDING_SHAPE_Z,
+	BINDING_SHAPE_V,
+	BINDING_SHAPE_CARET,
+	BINDING_IN,
+	BINDING_OUT,
+	/* driven by the gesture progress, see struct continuous_action */
+	BINDING_CONTINUOUS,
+	BINDING_DIRECTION_COUNT
+};
+
+enum action_type {
+	ACTION_NONE,
+	ACTION_WORKSPACE_NEXT,
+	ACTION_WORKSPACE_PREV,
+	ACTION_WORKSPACE_BACK_AND_FORTH,
+	ACTION_WORKSPACE_NEW,
+	ACTION_WORKSPACE_NEW_LOWEST,
+	ACTION_COMMAND,
+	ACTION_SPAWN,
+	ACTION_CONTINUOUS,
+	ACTION_TYPE_COUNT
+};
+
+/* prebuilt when the configuration is loaded */
+struct action {
+	enum action_type type;
+	/*
+	 * ACTION_COMMAND: sway command sent as is
+	 * ACTION_SPAWN: argc NUL terminated words, expanded on load
+	 */
+	char command[BINDING_COMMAND_SIZE];
+	unsigned int argc;
+	/* ACTION_CONTINUOUS */
+	struct continuous_action continuous;
+};
+
+/* dense table, dispatch is a single lookup */
+struct bindings {
+	bool early_commit;
+	/* swipe directions, from [swipe] diagonal_width */
+	struct sectors sectors;
+	/* a swipe shape is bound for that number of fingers */
+	bool shapes[BINDING_FINGERS_MAX + 1];
+	struct action actions[GESTURE_TYPE_COUNT][BINDING_FINGERS_MAX + 1]
+			     [BINDING_DIRECTION_COUNT];
+};
+
+/* parse an INI file, built-in defaults when path is NULL */
+struct bindings *bindings_load(const char *path);
+void bindings_destroy(struct bindings *bindings);
+
+/* default configuration file location, NULL if there is none */
+const char *bindings_default_path(void);
+
+/* table used by the recognizers */
+void bindings_set(struct bindings *bindings);
+struct bindings *bindings_get(void);
+
+/* swipes of nfingers go through the shape recognizer */
+bool binding_has_shapes(int nfingers);
+
+/* NULL when nothing is bound */
+const struct action *binding_lookup(enum gesture_type type, int nfingers,
+				    enum binding_direction direction);
+
+#endif
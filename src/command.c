@@ -1,20 +1,35 @@
 #define _GNU_SOURCE
+#include <errno.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <syslog.h>
 
-#include <json.h>
-
-#include "json_object.h"
 #include "sway/ipc-client.h"
 
+#include "binding.h"
 #include "command.h"
+#include "connection.h"
+#include "executor.h"
+#include "json-scan.h"
+#include "latency.h"
+#include "launch.h"
+#include "log.h"
+#include "workspace.h"
+
+/* commands pipelined to sway, more are coalesced while they run */
+#define COMMAND_MAX_INFLIGHT	4
+#define COMMAND_QUEUE_SIZE	16
+#define COMMAND_PAYLOAD_SIZE	1024
 
 enum sway_command {
 	SWAY_CMD_WORKSPACE_PREV,
 	SWAY_CMD_WORKSPACE_NEXT,
-	SWAY_CMD_WORKSPACE_BACK_AND_FORTH
+	SWAY_CMD_WORKSPACE_BACK_AND_FORTH,
+	SWAY_CMD_WORKSPACE_NEW,
+	SWAY_CMD_WORKSPACE_NEW_LOWEST,
+	/* command from the configuration, sent as is */
+	SWAY_CMD_RAW
 };
 
 const char * const sway_command_str[] = {
@@ -23,112 +38,463 @@ const char * const sway_command_str[] = {
 	[SWAY_CMD_WORKSPACE_BACK_AND_FORTH] = "workspace back_and_forth",
 };
 
-static char *sway_send_command(uint32_t type, const char *command)
+/*
+ * Actions waiting for the previous command to complete. Consecutive
+ * actions of the same kind are merged: 'next' and 'prev' add up to a
+ * signed number of steps stored in SWAY_CMD_WORKSPACE_NEXT entries.
+ * Raw commands are never merged.
+ */
+struct pending_command {
+	enum sway_command cmd;
+	int count;
+	/* copied, the bindings may be reloaded before it is sent */
+	char command[BINDING_COMMAND_SIZE];
+	/* of the first action merged into this one */
+	struct latency_trace trace;
+};
+
+/* ';' separated commands sent as a single IPC_COMMAND */
+struct batch {
+	char payload[COMMAND_PAYLOAD_SIZE];
+	size_t len;
+	/* focused workspace once the batch ran, -1 when unknown */
+	int focused;
+	int last;
+	/* a batch is timed after its oldest action */
+	struct latency_trace trace;
+};
+
+static struct {
+	/* long-lived sway IPC connection, shared by all commands */
+	struct connection *conn;
+
+	struct pending_command queue[COMMAND_QUEUE_SIZE];
+	unsigned int count;
+	unsigned int inflight;
+	/* sway is asked for workspaces on behalf of queue[0] */
+	bool querying;
+
+	/* replies come in order, at most COMMAND_MAX_INFLIGHT are pending */
+	struct latency_trace traces[COMMAND_MAX_INFLIGHT];
+	unsigned int next_trace;
+} command;
+
+static void command_flush(void);
+
+static int sway_send_command(uint32_t type, const char *cmd,
+			     connection_reply_cb cb, void *data)
 {
-	char *socket_path = get_socketpath();
-	int socketfd = ipc_open_socket(socket_path);
-	struct timeval timeout = {.tv_sec = 3, .tv_usec = 0};
-	ipc_set_recv_timeout(socketfd, timeout);
-	uint32_t len = strlen(command);
-	return ipc_single_command(socketfd, type, command, &len);
+	int ret;
+
+	if (!command.conn)
+		return -ENOTCONN;
+
+	ret = connection_send(command.conn, type, cmd, strlen(cmd), cb, data);
+	if (ret < 0)
+		log_err("Failed to send '%s' to sway: %s\n",
+			cmd, strerror(-ret));
+
+	return ret;
 }
 
-static void sway_send_enum_command(enum sway_command cmd)
+/* sway replies with one result object per ';' separated command */
+bool command_reply_ok(const char *payload, uint32_t len)
 {
-	char *resp = sway_send_command(IPC_COMMAND, sway_command_str[cmd]);
-	/* release unused response from sway */
-	free(resp);
+	struct json_span reply = { payload, len };
+	struct json_span result, error, msg;
+	struct json_scan it;
+	bool success, ok = true;
+
+	if (!payload) {
+		log_err("No reply from sway to command\n");
+		return false;
+	}
+
+	if (!json_scan_array(&it, &reply)) {
+		log_err("Malformed command reply from sway\n");
+		return false;
+	}
+
+	while (json_scan_array_next(&it, &result)) {
+		if (json_scan_get_bool(&result, "success", &success) && success)
+			continue;
+
+		ok = false;
+		if (json_scan_get(&result, "error", &error) &&
+		    json_scan_string(&error, &msg))
+			log_err("Sway command failed: %.*s\n",
+				(int)msg.len, msg.start);
+		else
+			log_err("Sway command failed\n");
+	}
+
+	return ok;
 }
 
-void command_workspace_next(void)
+static void command_reply(const char *payload, uint32_t len, void *data)
 {
-	sway_send_enum_command(SWAY_CMD_WORKSPACE_NEXT);
+	struct latency_trace *trace = data;
+
+	command.inflight--;
+	if (command_reply_ok(payload, len)) {
+		latency_stamp(trace, LATENCY_REPLY);
+		latency_record(trace);
+	}
+	command_flush();
 }
 
-void command_workspace_prev(void)
+static int command_send(uint32_t type, const char *cmd,
+			connection_reply_cb cb,
+			const struct latency_trace *trace)
 {
-	sway_send_enum_command(SWAY_CMD_WORKSPACE_PREV);
+	struct latency_trace *slot;
+	int ret;
+
+	slot = &command.traces[command.next_trace++ % COMMAND_MAX_INFLIGHT];
+	*slot = *trace;
+	latency_stamp(slot, LATENCY_WRITE);
+
+	/* the callback may run before the send returns, on write errors */
+	command.inflight++;
+	ret = sway_send_command(type, cmd, cb, slot);
+	if (ret < 0)
+		command.inflight--;
+
+	return ret;
 }
 
-void command_workspace_back_and_forth(void)
+static bool batch_append(struct batch *batch, const char *fmt, ...)
 {
-	sway_send_enum_command(SWAY_CMD_WORKSPACE_BACK_AND_FORTH);
+	size_t avail = sizeof(batch->payload) - batch->len;
+	va_list args;
+	int len;
+
+	if (batch->len > 0) {
+		if (avail < 2)
+			return false;
+		batch->payload[batch->len] = ';';
+		avail--;
+	}
+
+	va_start(args, fmt);
+	len = vsnprintf(batch->payload + sizeof(batch->payload) - avail,
+			avail, fmt, args);
+	va_end(args);
+
+	if (len < 0 || (size_t)len >= avail) {
+		batch->payload[batch->len] = '\0';
+		return false;
+	}
+
+	batch->len = sizeof(batch->payload) - avail + len;
+	return true;
 }
 
-void command_workspace_new(void)
+static bool batch_add_step(struct batch *batch, struct pending_command *pending)
 {
-	struct json_tokener *tok = NULL;
-	struct json_object *jobj = NULL;
-	struct json_object *json_workspace = NULL;
-	struct json_object *json_workspace_num = NULL;
-	struct json_object *json_workspace_focus = NULL;
-
-	int i, ret;
-	json_bool json_ret;
-	bool focused;
-	int workspace, max_workspace = 0;
-	char *cmd = NULL;
-	char *resp1 = NULL, *resp2 = NULL;
-
-	resp1 = sway_send_command(IPC_GET_WORKSPACES, "");
-	if (!resp1) {
-		syslog(LOG_ERR, "Failed to get workspaces from sway");
-		goto exit;
+	int target = -1;
+
+	if (pending->count == 0)
+		return true;
+
+	/* jump straight to the target when we know where 'next' leads */
+	if (batch->focused >= 0 && abs(pending->count) < workspace_count())
+		target = workspace_step(batch->focused, pending->count);
+
+	if (target >= 0) {
+		if (!batch_append(batch, "workspace number %d", target))
+			return false;
+		batch->focused = target;
+		return true;
 	}
 
-	tok = json_tokener_new_ex(JSON_MAX_DEPTH);
-	if (!tok) {
-		syslog(LOG_ERR, "Failed to allocate json tokener");
-		goto exit;
+	batch->focused = -1;
+	while (pending->count) {
+		enum sway_command cmd = pending->count > 0 ?
+			SWAY_CMD_WORKSPACE_NEXT : SWAY_CMD_WORKSPACE_PREV;
+
+		if (!batch_append(batch, "%s", sway_command_str[cmd]))
+			return false;
+		pending->count += pending->count > 0 ? -1 : 1;
+	}
+
+	return true;
+}
+
+/* returns false when the action must wait for another batch */
+static bool batch_add(struct batch *batch, struct pending_command *pending)
+{
+	switch (pending->cmd) {
+	case SWAY_CMD_WORKSPACE_NEXT:
+		return batch_add_step(batch, pending);
+
+	case SWAY_CMD_WORKSPACE_BACK_AND_FORTH:
+		/* going back and forth twice is a no-op */
+		if (pending->count % 2 == 0)
+			return true;
+		batch->focused = -1;
+		return batch_append(batch, "%s", sway_command_str[pending->cmd]);
+
+	case SWAY_CMD_WORKSPACE_NEW:
+		/*
+		 * The number is taken from sway first, or from the cache
+		 * once it reflects all the commands sent so far.
+		 */
+		if (!workspace_cache_valid() || command.inflight > 0)
+			return false;
+		if (batch->last <= 0)
+			return true;
+		/* intermediate new workspaces would be empty, skip them */
+		if (!batch_append(batch, "workspace %d",
+				  batch->last + pending->count))
+			return false;
+		batch->last += pending->count;
+		batch->focused = -1;
+		return true;
+
+	case SWAY_CMD_WORKSPACE_NEW_LOWEST:
+		if (!workspace_cache_valid() || command.inflight > 0)
+			return false;
+		/* the lowest free one stays free until we leave it */
+		if (workspace_first_free() <= 0)
+			return true;
+		if (!batch_append(batch, "workspace %d", workspace_first_free()))
+			return false;
+		if (workspace_first_free() > batch->last)
+			batch->last = workspace_first_free();
+		batch->focused = -1;
+		return true;
+
+	case SWAY_CMD_RAW:
+		batch->focused = -1;
+		return batch_append(batch, "%s", pending->command);
+
+	default:
+		return true;
 	}
+}
+
+static void workspace_new_reply(const char *payload, uint32_t len,
+				void *data)
+{
+	enum sway_command new_cmd = command.queue[0].cmd;
+	int count = command.queue[0].count;
+	struct latency_trace trace = *(struct latency_trace *)data;
+	int last, first_free, target;
+	char cmd[32];
 
-	jobj = json_tokener_parse_ex(tok, resp1, -1);
-	if (!jobj) {
-		syslog(LOG_ERR, "Failed to parse json string");
+	/* this query stands for the pending 'new workspace' action */
+	command.inflight--;
+	command.querying = false;
+	command.count--;
+	memmove(command.queue, command.queue + 1,
+		command.count * sizeof(command.queue[0]));
+
+	if (!payload) {
+		log_err("Failed to get workspaces from sway");
 		goto exit;
 	}
 
-	if (json_object_get_type(jobj) != json_type_array) {
-		syslog(LOG_ERR,
-		       "%s: Wrong JSON object type (%d), expect an array",
-		       __func__, json_object_get_type(jobj));
+	if (!workspace_scan(payload, len, &last, &first_free)) {
+		log_err("%s: Malformed workspaces list, expect an array",
+			__func__);
 		goto exit;
 	}
 
-	for (i = 0; i < json_object_array_length(jobj); i++) {
-		json_workspace = json_object_array_get_idx(jobj, i);
-		if (!json_workspace)
-			continue;
+	if (new_cmd == SWAY_CMD_WORKSPACE_NEW_LOWEST)
+		target = first_free;
+	else
+		target = last > 0 ? last + count : -1;
 
-		json_ret = json_object_object_get_ex(json_workspace, "num", &json_workspace_num);
-		if (!json_ret)
-			continue;
+	if (target > 0) {
+		snprintf(cmd, sizeof(cmd), "workspace %d", target);
+		command_send(IPC_COMMAND, cmd, command_reply, &trace);
+	}
 
-		json_ret = json_object_object_get_ex(json_workspace, "focused", &json_workspace_focus);
-		if (!json_ret)
-			continue;
+exit:
+	command_flush();
+}
+
+static void command_flush(void)
+{
+	struct batch batch = { .len = 0 };
+	unsigned int i;
+
+	if (command.inflight >= COMMAND_MAX_INFLIGHT || command.count == 0 ||
+	    command.querying)
+		return;
+
+	/*
+	 * Workspace events of the commands in flight are still to come,
+	 * the cache only tells where 'next' leads when none is.
+	 */
+	batch.focused = command.inflight == 0 && workspace_ordered() ?
+			workspace_focused() : -1;
+	batch.last = workspace_last();
+	batch.trace = command.queue[0].trace;
 
-		workspace = json_object_get_int(json_workspace_num);
-		if (workspace > max_workspace)
-			max_workspace = workspace;
+	for (i = 0; i < command.count; i++)
+		if (!batch_add(&batch, &command.queue[i]))
+			break;
 
-		focused = json_object_get_boolean(json_workspace_focus);
-		if (focused)
-			syslog(LOG_INFO, "Workspace focused = %d", workspace);
+	command.count -= i;
+	memmove(command.queue, command.queue + i,
+		command.count * sizeof(command.queue[0]));
+
+	if (batch.len > 0) {
+		log_debug("%s: %s\n", __func__, batch.payload);
+		command_send(IPC_COMMAND, batch.payload, command_reply,
+			     &batch.trace);
+		return;
 	}
 
-	if (max_workspace == 0)
-		goto exit;
+	/* not subscribed (yet), the command is sent once sway replied */
+	if (command.count == 0 || workspace_cache_valid() ||
+	    (command.queue[0].cmd != SWAY_CMD_WORKSPACE_NEW &&
+	     command.queue[0].cmd != SWAY_CMD_WORKSPACE_NEW_LOWEST))
+		return;
 
-	ret = asprintf(&cmd, "workspace %d", max_workspace + 1);
-	if (ret < 0)
-		goto exit;
+	command.querying = true;
+	if (command_send(IPC_GET_WORKSPACES, "", workspace_new_reply,
+			 &command.queue[0].trace) < 0) {
+		command.querying = false;
+		command.count--;
+		memmove(command.queue, command.queue + 1,
+			command.count * sizeof(command.queue[0]));
+	}
+}
+
+static void command_queue(enum sway_command cmd, int count,
+			  const struct action *action,
+			  const struct latency_trace *trace)
+{
+	struct pending_command *last = NULL;
 
-	resp2 = sway_send_command(IPC_COMMAND, cmd);
+	if (command.count > 0)
+		last = &command.queue[command.count - 1];
 
-exit:
-	json_tokener_free(tok);
-	free(resp1);
-	free(resp2);
-	free(cmd);
+	if (last && last->cmd == cmd && cmd != SWAY_CMD_RAW) {
+		last->count += count;
+	} else if (command.count == COMMAND_QUEUE_SIZE) {
+		log_err("Too many pending commands, dropping one\n");
+		return;
+	} else {
+		last = &command.queue[command.count++];
+		last->cmd = cmd;
+		last->count = count;
+		if (cmd == SWAY_CMD_RAW)
+			snprintf(last->command, sizeof(last->command), "%s",
+				 action->command);
+		last->trace = *trace;
+		last->trace.action = action ? action->type : ACTION_NONE;
+	}
+
+	command_flush();
+}
+
+void command_workspace_next(void)
+{
+	command_queue(SWAY_CMD_WORKSPACE_NEXT, 1, NULL,
+		      latency_current());
+}
+
+void command_workspace_prev(void)
+{
+	command_queue(SWAY_CMD_WORKSPACE_NEXT, -1, NULL,
+		      latency_current());
+}
+
+void command_workspace_back_and_forth(void)
+{
+	command_queue(SWAY_CMD_WORKSPACE_BACK_AND_FORTH, 1, NULL,
+		      latency_current());
+}
+
+void command_workspace_new(void)
+{
+	command_queue(SWAY_CMD_WORKSPACE_NEW, 1, NULL,
+		      latency_current());
+}
+
+void command_workspace_new_lowest(void)
+{
+	command_queue(SWAY_CMD_WORKSPACE_NEW_LOWEST, 1, NULL,
+		      latency_current());
+}
+
+/*
+ * Programs start right away, ahead of the sway commands still queued.
+ * The trace ends once the program is running.
+ */
+static void command_spawn(const struct action *action,
+			  const struct latency_trace *trace)
+{
+	struct latency_trace spawn_trace = *trace;
+
+	spawn_trace.action = ACTION_SPAWN;
+	latency_stamp(&spawn_trace, LATENCY_WRITE);
+	if (launch_action(action) < 0)
+		return;
+
+	latency_stamp(&spawn_trace, LATENCY_REPLY);
+	latency_record(&spawn_trace);
+}
+
+void command_dispatch(const struct action *action,
+		      const struct latency_trace *trace)
+{
+	switch (action->type) {
+	case ACTION_WORKSPACE_NEXT:
+		command_queue(SWAY_CMD_WORKSPACE_NEXT, 1, action, trace);
+		break;
+	case ACTION_WORKSPACE_PREV:
+		command_queue(SWAY_CMD_WORKSPACE_NEXT, -1, action, trace);
+		break;
+	case ACTION_WORKSPACE_BACK_AND_FORTH:
+		command_queue(SWAY_CMD_WORKSPACE_BACK_AND_FORTH, 1, action,
+			      trace);
+		break;
+	case ACTION_WORKSPACE_NEW:
+		command_queue(SWAY_CMD_WORKSPACE_NEW, 1, action, trace);
+		break;
+	case ACTION_WORKSPACE_NEW_LOWEST:
+		command_queue(SWAY_CMD_WORKSPACE_NEW_LOWEST, 1, action,
+			      trace);
+		break;
+	case ACTION_COMMAND:
+		command_queue(SWAY_CMD_RAW, 1, action, trace);
+		break;
+	case ACTION_SPAWN:
+		command_spawn(action, trace);
+		break;
+	default:
+		/* continuous actions are driven by a throttle */
+		break;
+	}
+}
+
+void command_execute(const struct action *action)
+{
+	if (executor_running())
+		executor_execute(action, latency_current());
+	else
+		command_dispatch(action, latency_current());
+}
+
+int command_run(const char *cmd, connection_reply_cb cb, void *data)
+{
+	if (executor_running())
+		return executor_run(cmd, cb, data);
+
+	return command_run_now(cmd, cb, data);
+}
+
+int command_run_now(const char *cmd, connection_reply_cb cb, void *data)
+{
+	return sway_send_command(IPC_COMMAND, cmd, cb, data);
+}
+
+void command_init(struct connection *conn)
+{
+	command.conn = conn;
 }
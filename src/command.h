@@ -1,9 +1,39 @@
 #ifndef _COMMAND_H_
 #define _COMMAND_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "connection.h"
+
+struct action;
+struct latency_trace;
+
 void command_workspace_next(void);
 void command_workspace_prev(void);
 void command_workspace_back_and_forth(void);
 void command_workspace_new(void);
+void command_workspace_new_lowest(void);
+
+/* queue the discrete action of a binding */
+void command_execute(const struct action *action);
+
+/*
+ * Send a command right away, outside of the coalescing queue. cb gets the
+ * raw reply, command_reply_ok() reports failures in it.
+ */
+int command_run(const char *cmd, connection_reply_cb cb, void *data);
+bool command_reply_ok(const char *payload, uint32_t len);
+
+/*
+ * Both of the above hand over to the executor thread when it runs. These
+ * only run on the thread owning the connection, see executor.h.
+ */
+void command_dispatch(const struct action *action,
+		      const struct latency_trace *trace);
+int command_run_now(const char *cmd, connection_reply_cb cb, void *data);
+
+/* commands are sent asynchronously through this sway connection */
+void command_init(struct connection *conn);
 
 #endif
@@ -0,0 +1,114 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/inotify.h>
+
+#include "config-watch.h"
+#include "log.h"
+
+struct config_watch {
+	int fd;
+	char *path;
+	/* file name within the watched directory */
+	const char *name;
+};
+
+struct config_watch *config_watch_new(const char *path)
+{
+	struct config_watch *watch;
+	char *dir = NULL;
+	char *slash;
+	int ret;
+
+	watch = calloc(1, sizeof(*watch));
+	if (!watch)
+		return NULL;
+	watch->fd = -1;
+
+	watch->path = strdup(path);
+	dir = strdup(path);
+	if (!watch->path || !dir)
+		goto error;
+
+	slash = strrchr(dir, '/');
+	if (slash) {
+		watch->name = watch->path + (slash - dir) + 1;
+		/* keep the root directory */
+		slash[slash == dir ? 1 : 0] = '\0';
+	} else {
+		watch->name = watch->path;
+		strcpy(dir, ".");
+	}
+
+	watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (watch->fd < 0) {
+		log_err("Failed to create inotify instance: %s\n",
+			strerror(errno));
+		goto error;
+	}
+
+	ret = inotify_add_watch(watch->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (ret < 0) {
+		log_info("Not watching %s for changes: %s\n", dir,
+			 strerror(errno));
+		goto error;
+	}
+
+	log_info("Watching %s for changes\n", watch->path);
+	free(dir);
+	return watch;
+
+error:
+	free(dir);
+	config_watch_destroy(watch);
+	return NULL;
+}
+
+void config_watch_destroy(struct config_watch *watch)
+{
+	if (!watch)
+		return;
+
+	if (watch->fd >= 0)
+		close(watch->fd);
+	free(watch->path);
+	free(watch);
+}
+
+int config_watch_get_fd(struct config_watch *watch)
+{
+	return watch ? watch->fd : -1;
+}
+
+const char *config_watch_get_path(struct config_watch *watch)
+{
+	return watch->path;
+}
+
+bool config_watch_changed(struct config_watch *watch)
+{
+	char buf[4096]
+		__attribute__((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *event;
+	bool changed = false;
+	ssize_t len;
+	char *p;
+
+	for (;;) {
+		len = read(watch->fd, buf, sizeof(buf));
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len <= 0)
+			break;
+
+		for (p = buf; p < buf + len; p += sizeof(*event) + event->len) {
+			event = (const struct inotify_event *)p;
+			if (event->len && !strcmp(event->name, watch->name))
+				changed = true;
+		}
+	}
+
+	return changed;
+}
@@ -0,0 +1,22 @@
+#ifndef _CONFIG_WATCH_H_
+#define _CONFIG_WATCH_H_
+
+#include <stdbool.h>
+
+struct config_watch;
+
+/*
+ * Watch a configuration file for changes. The parent directory is watched
+ * so that files replaced by a rename, as most editors do, or created later
+ * are noticed too. NULL if the directory cannot be watched.
+ */
+struct config_watch *config_watch_new(const char *path);
+void config_watch_destroy(struct config_watch *watch);
+
+int config_watch_get_fd(struct config_watch *watch);
+const char *config_watch_get_path(struct config_watch *watch);
+
+/* drain pending notifications, true if the file was written or replaced */
+bool config_watch_changed(struct config_watch *watch);
+
+#endif
@@ -0,0 +1,431 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+
+#include "sway/ipc-client.h"
+
+#include "connection.h"
+#include "log.h"
+#include "loop.h"
+
+#define RX_CHUNK_SIZE	4096
+
+struct buffer {
+	char *data;
+	size_t len;
+	size_t size;
+};
+
+struct request {
+	connection_reply_cb cb;
+	void *data;
+	/* header and payload size in the tx buffer */
+	size_t size;
+};
+
+struct connection {
+	char *socket_path;
+	int fd;
+	/*
+	 * Bumped on every close. Callbacks may close and reopen the
+	 * connection, the fd alone does not tell the buffers were reset.
+	 */
+	unsigned int generation;
+
+	const struct connection_ops *ops;
+	void *ops_data;
+
+	/* serialized requests, the first tx_ready bytes may be written */
+	struct buffer tx;
+	size_t tx_ready;
+
+	/* received bytes not yet consumed */
+	struct buffer rx;
+
+	/*
+	 * FIFO of requests, the first 'inflight' ones have been released
+	 * to the socket and are waiting for their reply.
+	 */
+	struct request queue[CONNECTION_QUEUE_SIZE];
+	unsigned int head;
+	unsigned int count;
+	unsigned int inflight;
+	/* restarted on every reply, 0 while nothing is in flight */
+	uint64_t deadline_usec;
+};
+
+static int buffer_reserve(struct buffer *buf, size_t len)
+{
+	size_t size = buf->size ? buf->size : RX_CHUNK_SIZE;
+	char *data;
+
+	if (buf->len + len <= buf->size)
+		return 0;
+
+	while (size < buf->len + len)
+		size *= 2;
+
+	data = realloc(buf->data, size);
+	if (!data)
+		return -ENOMEM;
+
+	buf->data = data;
+	buf->size = size;
+	return 0;
+}
+
+static void buffer_consume(struct buffer *buf, size_t len)
+{
+	buf->len -= len;
+	memmove(buf->data, buf->data + len, buf->len);
+}
+
+static void connection_close(struct connection *conn)
+{
+	struct request pending[CONNECTION_QUEUE_SIZE];
+	unsigned int i, count = conn->count;
+	bool connected = conn->fd >= 0;
+
+	if (connected) {
+		log_info("Closing sway connection\n");
+		close(conn->fd);
+	}
+	conn->fd = -1;
+	conn->generation++;
+
+	for (i = 0; i < count; i++)
+		pending[i] = conn->queue[(conn->head + i) %
+					 CONNECTION_QUEUE_SIZE];
+
+	conn->tx.len = 0;
+	conn->tx_ready = 0;
+	conn->rx.len = 0;
+	conn->head = 0;
+	conn->count = 0;
+	conn->inflight = 0;
+	conn->deadline_usec = 0;
+
+	/* callbacks may queue new requests, state must be clean by now */
+	for (i = 0; i < count; i++)
+		if (pending[i].cb)
+			pending[i].cb(NULL, 0, pending[i].data);
+
+	if (connected && conn->ops && conn->ops->disconnected)
+		conn->ops->disconnected(conn, conn->ops_data);
+}
+
+static int connection_open(struct connection *conn)
+{
+	int flags, err;
+
+	if (conn->fd >= 0)
+		return 0;
+
+	/* resolving the path may fork sway, only do it once */
+	if (!conn->socket_path) {
+		conn->socket_path = get_socketpath();
+		if (!conn->socket_path) {
+			log_err("Failed to get sway socket path\n");
+			return -ENOENT;
+		}
+	}
+
+	conn->fd = ipc_open_socket(conn->socket_path);
+	if (conn->fd < 0) {
+		/* sway may have been restarted on another socket */
+		free(conn->socket_path);
+		conn->socket_path = NULL;
+		return -ENOTCONN;
+	}
+
+	flags = fcntl(conn->fd, F_GETFL);
+	if (flags < 0 || fcntl(conn->fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+		err = errno;
+		log_err("Failed to make sway socket non-blocking: %s\n",
+			strerror(err));
+		connection_close(conn);
+		return -err;
+	}
+
+	/* e.g. subscribe to events, ahead of any request being queued */
+	if (conn->ops && conn->ops->connected)
+		conn->ops->connected(conn, conn->ops_data);
+
+	return conn->fd >= 0 ? 0 : -ENOTCONN;
+}
+
+/* release queued requests to the socket, up to the pipeline depth */
+static void connection_promote(struct connection *conn)
+{
+	unsigned int i;
+
+	if (conn->inflight == 0 && conn->count > 0)
+		conn->deadline_usec = loop_now() + CONNECTION_REPLY_TIMEOUT_USEC;
+
+	while (conn->inflight < conn->count &&
+	       conn->inflight < CONNECTION_MAX_INFLIGHT) {
+		i = (conn->head + conn->inflight) % CONNECTION_QUEUE_SIZE;
+		conn->tx_ready += conn->queue[i].size;
+		conn->inflight++;
+	}
+}
+
+static int connection_flush(struct connection *conn)
+{
+	ssize_t sent;
+
+	while (conn->tx_ready > 0) {
+		sent = send(conn->fd, conn->tx.data, conn->tx_ready,
+			    MSG_NOSIGNAL);
+		if (sent < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+
+			log_err("Failed to write to sway: %s\n",
+				strerror(errno));
+			connection_close(conn);
+			return -EPIPE;
+		}
+
+		buffer_consume(&conn->tx, sent);
+		conn->tx_ready -= sent;
+	}
+
+	return 0;
+}
+
+static void connection_handle(struct connection *conn, uint32_t type,
+			      const char *payload, uint32_t len)
+{
+	struct request *req;
+
+	/* events have the highest bit set */
+	if (type & (1u << 31)) {
+		if (conn->ops && conn->ops->event)
+			conn->ops->event(conn, type, payload, len,
+					 conn->ops_data);
+		return;
+	}
+
+	if (conn->inflight == 0) {
+		log_err("Unexpected reply from sway (type %u)\n", type);
+		return;
+	}
+
+	req = &conn->queue[conn->head];
+	conn->head = (conn->head + 1) % CONNECTION_QUEUE_SIZE;
+	conn->count--;
+	conn->inflight--;
+	conn->deadline_usec = conn->inflight ?
+			      loop_now() + CONNECTION_REPLY_TIMEOUT_USEC : 0;
+
+	if (req->cb)
+		req->cb(payload, len, req->data);
+}
+
+static int connection_process(struct connection *conn)
+{
+	unsigned int generation = conn->generation;
+	size_t off = 0;
+	uint32_t type, len;
+	char *payload, saved;
+
+	while (conn->rx.len - off >= IPC_HEADER_SIZE) {
+		if (!ipc_header_decode(conn->rx.data + off, &type, &len)) {
+			log_err("Malformed IPC message from sway\n");
+			connection_close(conn);
+			return -EPROTO;
+		}
+
+		if (conn->rx.len - off - IPC_HEADER_SIZE < len)
+			break;
+
+		/* NUL terminate in place, rx always has a spare byte */
+		payload = conn->rx.data + off + IPC_HEADER_SIZE;
+		saved = payload[len];
+		payload[len] = '\0';
+
+		connection_handle(conn, type, payload, len);
+
+		/* the callback tore the connection down, maybe reopened it */
+		if (conn->generation != generation)
+			return conn->fd >= 0 ? 0 : -ENOTCONN;
+
+		payload[len] = saved;
+		off += IPC_HEADER_SIZE + len;
+	}
+
+	buffer_consume(&conn->rx, off);
+	return 0;
+}
+
+static int connection_read(struct connection *conn)
+{
+	ssize_t received;
+	int ret;
+
+	for (;;) {
+		ret = buffer_reserve(&conn->rx, RX_CHUNK_SIZE + 1);
+		if (ret < 0) {
+			connection_close(conn);
+			return ret;
+		}
+
+		received = recv(conn->fd, conn->rx.data + conn->rx.len,
+				conn->rx.size - conn->rx.len - 1, 0);
+		if (received < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+
+			log_err("Failed to read from sway: %s\n",
+				strerror(errno));
+			connection_close(conn);
+			return -EPIPE;
+		}
+
+		if (received == 0) {
+			log_err("Sway closed the IPC connection\n");
+			connection_close(conn);
+			return -EPIPE;
+		}
+
+		conn->rx.len += received;
+	}
+
+	return connection_process(conn);
+}
+
+struct connection *connection_new(void)
+{
+	struct connection *conn;
+
+	conn = calloc(1, sizeof(*conn));
+	if (!conn)
+		return NULL;
+
+	conn->fd = -1;
+	return conn;
+}
+
+void connection_destroy(struct connection *conn)
+{
+	if (!conn)
+		return;
+
+	connection_close(conn);
+	free(conn->socket_path);
+	free(conn->tx.data);
+	free(conn->rx.data);
+	free(conn);
+}
+
+void connection_set_ops(struct connection *conn,
+			const struct connection_ops *ops, void *data)
+{
+	conn->ops = ops;
+	conn->ops_data = data;
+}
+
+int connection_connect(struct connection *conn)
+{
+	return connection_open(conn);
+}
+
+int connection_send(struct connection *conn, uint32_t type,
+		    const char *payload, uint32_t len,
+		    connection_reply_cb cb, void *data)
+{
+	struct request *req;
+	int ret;
+
+	if (conn->count == CONNECTION_QUEUE_SIZE)
+		return -EBUSY;
+
+	ret = connection_open(conn);
+	if (ret < 0)
+		return ret;
+
+	ret = buffer_reserve(&conn->tx, IPC_HEADER_SIZE + len);
+	if (ret < 0)
+		return ret;
+
+	ipc_header_encode(conn->tx.data + conn->tx.len, type, len);
+	memcpy(conn->tx.data + conn->tx.len + IPC_HEADER_SIZE, payload, len);
+	conn->tx.len += IPC_HEADER_SIZE + len;
+
+	req = &conn->queue[(conn->head + conn->count) % CONNECTION_QUEUE_SIZE];
+	req->cb = cb;
+	req->data = data;
+	req->size = IPC_HEADER_SIZE + len;
+	conn->count++;
+
+	connection_promote(conn);
+	/* write errors are reported through the reply callback */
+	connection_flush(conn);
+	return 0;
+}
+
+void connection_update_timer(struct connection *conn, struct loop *loop,
+			     struct loop_timer *timer)
+{
+	/* most iterations change nothing */
+	if (timer->deadline_usec == conn->deadline_usec)
+		return;
+
+	if (conn->deadline_usec)
+		loop_timer_arm(loop, timer, conn->deadline_usec);
+	else
+		loop_timer_disarm(loop, timer);
+}
+
+void connection_timeout(struct connection *conn)
+{
+	if (!conn->deadline_usec || loop_now() < conn->deadline_usec)
+		return;
+
+	/* reconnected on the next request */
+	log_err("No reply from sway in %d ms, closing the connection\n",
+		CONNECTION_REPLY_TIMEOUT_USEC / 1000);
+	connection_close(conn);
+}
+
+int connection_get_fd(struct connection *conn)
+{
+	return conn->fd;
+}
+
+short connection_get_events(struct connection *conn)
+{
+	if (conn->fd < 0)
+		return 0;
+
+	return POLLIN | (conn->tx_ready ? POLLOUT : 0);
+}
+
+int connection_dispatch(struct connection *conn, short revents)
+{
+	int ret = 0;
+
+	if (conn->fd < 0)
+		return -ENOTCONN;
+
+	if (revents & (POLLIN | POLLHUP | POLLERR)) {
+		ret = connection_read(conn);
+		if (ret < 0)
+			return ret;
+	}
+
+	connection_promote(conn);
+	return connection_flush(conn);
+}
@@ -0,0 +1,62 @@
+#ifndef _CONNECTION_H_
+#define _CONNECTION_H_
+
+#include <stdint.h>
+
+/* maximum number of requests queued on the sway connection */
+#define CONNECTION_QUEUE_SIZE	32
+/* requests written to sway without waiting for the previous replies */
+#define CONNECTION_MAX_INFLIGHT	CONNECTION_QUEUE_SIZE
+/* sway is given up on when it does not reply for that long */
+#define CONNECTION_REPLY_TIMEOUT_USEC	3000000
+
+struct connection;
+struct loop;
+struct loop_timer;
+
+/*
+ * Called once the reply to a request has been received. Requests are
+ * pipelined and sway answers them in order, callbacks run in the order
+ * the requests were sent. On connection failure the callback is still
+ * called, with a NULL payload.
+ * The payload is NUL terminated and only valid during the callback.
+ */
+typedef void (*connection_reply_cb)(const char *payload, uint32_t len,
+				    void *data);
+
+/* connection lifecycle and sway events notifications */
+struct connection_ops {
+	void (*connected)(struct connection *conn, void *data);
+	void (*disconnected)(struct connection *conn, void *data);
+	void (*event)(struct connection *conn, uint32_t type,
+		      const char *payload, uint32_t len, void *data);
+};
+
+struct connection *connection_new(void);
+void connection_destroy(struct connection *conn);
+
+void connection_set_ops(struct connection *conn,
+			const struct connection_ops *ops, void *data);
+
+/* connect now instead of on the first request */
+int connection_connect(struct connection *conn);
+
+/* queue a request, the reply is delivered asynchronously to cb */
+int connection_send(struct connection *conn, uint32_t type,
+		    const char *payload, uint32_t len,
+		    connection_reply_cb cb, void *data);
+
+/* main loop integration, fd is -1 while disconnected */
+int connection_get_fd(struct connection *conn);
+short connection_get_events(struct connection *conn);
+int connection_dispatch(struct connection *conn, short revents);
+
+/*
+ * Keep timer armed at the deadline of the next reply, its callback calls
+ * connection_timeout() which fails the pending requests once it passed.
+ */
+void connection_update_timer(struct connection *conn, struct loop *loop,
+			     struct loop_timer *timer);
+void connection_timeout(struct connection *conn);
+
+#endif
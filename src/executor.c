@@ -0,0 +1,435 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "binding.h"
+#include "command.h"
+#include "connection.h"
+#include "executor.h"
+#include "latency.h"
+#include "log.h"
+#include "loop.h"
+
+/* longer replies are checked on the executor and summed up */
+#define EXECUTOR_REPLY_SIZE	256
+
+static const char reply_success[] = "[{\"success\": true}]";
+static const char reply_failure[] = "[{\"success\": false}]";
+
+enum executor_op {
+	/* command_execute() */
+	EXECUTOR_ACTION,
+	/* command_run() */
+	EXECUTOR_RUN,
+};
+
+/* copied into the ring, the input thread keeps nothing pointed to */
+struct executor_request {
+	enum executor_op op;
+	/* EXECUTOR_ACTION, stamped on the input thread */
+	struct latency_trace trace;
+	/* EXECUTOR_RUN, only called back on the input thread */
+	connection_reply_cb cb;
+	void *data;
+	union {
+		struct action action;
+		char command[BINDING_COMMAND_SIZE];
+	};
+};
+
+/* executor_run() request waiting for sway */
+struct executor_run {
+	connection_reply_cb cb;
+	void *data;
+};
+
+struct executor_reply {
+	connection_reply_cb cb;
+	void *data;
+	/* no reply from sway */
+	bool failed;
+	uint32_t len;
+	char payload[EXECUTOR_REPLY_SIZE];
+};
+
+/*
+ * Single-producer single-consumer ring indices. They only ever grow, the
+ * slot is the index modulo EXECUTOR_QUEUE_SIZE. A slot is written before
+ * head is released and read before tail is.
+ */
+struct ring {
+	atomic_uint head;
+	atomic_uint tail;
+};
+
+static struct {
+	pthread_t thread;
+	/* only read and written by the input thread */
+	bool running;
+	atomic_bool stop;
+
+	/* owned by the executor thread once started */
+	struct connection *conn;
+	struct loop *loop;
+	struct loop_source *sway_source;
+	struct loop_timer sway_timer;
+	struct loop_source *request_source;
+
+	/* eventfds, written once per request and per reply */
+	int request_fd;
+	int reply_fd;
+
+	struct ring requests;
+	struct executor_request request_slots[EXECUTOR_QUEUE_SIZE];
+	struct ring replies;
+	struct executor_reply reply_slots[EXECUTOR_QUEUE_SIZE];
+
+	/* replies come in order, at most CONNECTION_QUEUE_SIZE are pending */
+	struct executor_run runs[CONNECTION_QUEUE_SIZE];
+	unsigned int next_run;
+
+	/* metrics, written by the input thread */
+	unsigned int max_depth;
+	unsigned long dropped;
+} executor = {
+	.request_fd = -1,
+	.reply_fd = -1,
+};
+
+/* slot to fill, -1 when full */
+static int ring_produce_slot(struct ring *ring)
+{
+	unsigned int head = atomic_load_explicit(&ring->head,
+						 memory_order_relaxed);
+
+	if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) ==
+	    EXECUTOR_QUEUE_SIZE)
+		return -1;
+
+	return head % EXECUTOR_QUEUE_SIZE;
+}
+
+static void ring_produce(struct ring *ring)
+{
+	atomic_fetch_add_explicit(&ring->head, 1, memory_order_release);
+}
+
+/* slot to read, -1 when empty */
+static int ring_consume_slot(struct ring *ring)
+{
+	unsigned int tail = atomic_load_explicit(&ring->tail,
+						 memory_order_relaxed);
+
+	if (atomic_load_explicit(&ring->head, memory_order_acquire) == tail)
+		return -1;
+
+	return tail % EXECUTOR_QUEUE_SIZE;
+}
+
+static void ring_consume(struct ring *ring)
+{
+	atomic_fetch_add_explicit(&ring->tail, 1, memory_order_release);
+}
+
+static unsigned int ring_depth(struct ring *ring)
+{
+	return atomic_load_explicit(&ring->head, memory_order_relaxed) -
+	       atomic_load_explicit(&ring->tail, memory_order_relaxed);
+}
+
+static void executor_wake(int fd)
+{
+	uint64_t one = 1;
+
+	/* only fails when the counter would overflow, it is awake anyway */
+	if (write(fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		log_err("Failed to wake up executor: %s\n", strerror(errno));
+}
+
+static void executor_clear(int fd)
+{
+	uint64_t count;
+
+	if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+		log_err("Failed to read executor event: %s\n",
+			strerror(errno));
+}
+
+/* input thread side */
+
+static struct executor_request *executor_request_slot(void)
+{
+	unsigned int depth;
+	int slot;
+
+	slot = ring_produce_slot(&executor.requests);
+	if (slot < 0) {
+		if (executor.dropped++ == 0)
+			log_err("Executor queue full, dropping actions\n");
+		return NULL;
+	}
+
+	depth = ring_depth(&executor.requests) + 1;
+	if (depth > executor.max_depth)
+		executor.max_depth = depth;
+
+	return &executor.request_slots[slot];
+}
+
+static void executor_request_push(void)
+{
+	ring_produce(&executor.requests);
+	executor_wake(executor.request_fd);
+}
+
+int executor_execute(const struct action *action,
+		     const struct latency_trace *trace)
+{
+	struct executor_request *request = executor_request_slot();
+
+	if (!request)
+		return -EAGAIN;
+
+	request->op = EXECUTOR_ACTION;
+	request->trace = *trace;
+	request->action = *action;
+	executor_request_push();
+	return 0;
+}
+
+int executor_run(const char *cmd, connection_reply_cb cb, void *data)
+{
+	struct executor_request *request;
+
+	if (strlen(cmd) >= sizeof(request->command))
+		return -EINVAL;
+
+	request = executor_request_slot();
+	if (!request)
+		return -EAGAIN;
+
+	request->op = EXECUTOR_RUN;
+	request->cb = cb;
+	request->data = data;
+	strcpy(request->command, cmd);
+	executor_request_push();
+	return 0;
+}
+
+int executor_get_fd(void)
+{
+	return executor.running ? executor.reply_fd : -1;
+}
+
+void executor_complete(void)
+{
+	struct executor_reply *reply;
+	int slot;
+
+	executor_clear(executor.reply_fd);
+
+	while ((slot = ring_consume_slot(&executor.replies)) >= 0) {
+		reply = &executor.reply_slots[slot];
+		if (reply->failed)
+			reply->cb(NULL, 0, reply->data);
+		else
+			reply->cb(reply->payload, reply->len, reply->data);
+		ring_consume(&executor.replies);
+	}
+}
+
+void executor_dump(void)
+{
+	if (!executor.running)
+		return;
+
+	log_info("executor: queue depth %u max %u dropped %lu\n",
+		 ring_depth(&executor.requests), executor.max_depth,
+		 executor.dropped);
+}
+
+/* executor thread side */
+
+static void executor_reply(const char *payload, uint32_t len, void *data)
+{
+	struct executor_reply *reply;
+	struct executor_run *run = data;
+	int slot;
+
+	/* the input thread only waits on a few runs at once */
+	slot = ring_produce_slot(&executor.replies);
+	if (slot < 0) {
+		log_err("Executor reply queue full, dropping a reply\n");
+		return;
+	}
+
+	reply = &executor.reply_slots[slot];
+	reply->cb = run->cb;
+	reply->data = run->data;
+	reply->failed = !payload;
+
+	if (payload && len >= sizeof(reply->payload)) {
+		/* errors are logged from here, only the outcome crosses */
+		payload = command_reply_ok(payload, len) ? reply_success :
+							  reply_failure;
+		len = strlen(payload);
+	}
+
+	if (payload) {
+		memcpy(reply->payload, payload, len);
+		reply->payload[len] = '\0';
+		reply->len = len;
+	}
+
+	ring_produce(&executor.replies);
+	executor_wake(executor.reply_fd);
+}
+
+static void executor_send(struct executor_request *request)
+{
+	struct executor_run *run;
+	int ret;
+
+	run = &executor.runs[executor.next_run++ % CONNECTION_QUEUE_SIZE];
+	run->cb = request->cb;
+	run->data = request->data;
+
+	/* the input thread was told it is queued, it waits for a reply */
+	ret = command_run_now(request->command, executor_reply, run);
+	if (ret < 0)
+		executor_reply(NULL, 0, run);
+}
+
+static void request_ready(uint32_t revents, void *data)
+{
+	struct executor_request *request;
+	int slot;
+
+	executor_clear(executor.request_fd);
+
+	while ((slot = ring_consume_slot(&executor.requests)) >= 0) {
+		request = &executor.request_slots[slot];
+
+		if (request->op == EXECUTOR_ACTION)
+			command_dispatch(&request->action, &request->trace);
+		else
+			executor_send(request);
+
+		ring_consume(&executor.requests);
+	}
+}
+
+static void sway_ready(uint32_t revents, void *data)
+{
+	connection_dispatch(executor.conn, revents);
+}
+
+static void sway_expire(void *data)
+{
+	connection_timeout(executor.conn);
+}
+
+static void *executor_main(void *data)
+{
+	/* it is fine if sway is not up yet */
+	connection_connect(executor.conn);
+
+	while (!atomic_load_explicit(&executor.stop, memory_order_acquire)) {
+		loop_update(executor.loop, executor.sway_source,
+			    connection_get_fd(executor.conn),
+			    connection_get_events(executor.conn));
+		connection_update_timer(executor.conn, executor.loop,
+					&executor.sway_timer);
+
+		if (loop_dispatch(executor.loop) < 0)
+			break;
+	}
+
+	return NULL;
+}
+
+static void executor_cleanup(void)
+{
+	loop_destroy(executor.loop);
+	executor.loop = NULL;
+
+	if (executor.request_fd >= 0)
+		close(executor.request_fd);
+	if (executor.reply_fd >= 0)
+		close(executor.reply_fd);
+	executor.request_fd = -1;
+	executor.reply_fd = -1;
+}
+
+/* signals blocked by the caller stay blocked on the executor thread */
+int executor_start(struct connection *conn)
+{
+	int ret;
+
+	executor.conn = conn;
+
+	executor.loop = loop_new();
+	if (!executor.loop)
+		return -ENOMEM;
+
+	executor.request_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	executor.reply_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (executor.request_fd < 0 || executor.reply_fd < 0) {
+		ret = -errno;
+		log_err("Failed to create executor eventfd: %s\n",
+			strerror(-ret));
+		goto exit;
+	}
+
+	loop_timer_init(&executor.sway_timer, sway_expire, NULL);
+
+	/* reap sway replies before sending new requests */
+	executor.sway_source = loop_add(executor.loop, -1, 0, sway_ready, NULL);
+	executor.request_source = loop_add(executor.loop, executor.request_fd,
+					   EPOLLIN, request_ready, NULL);
+	if (!executor.sway_source || !executor.request_source) {
+		ret = -ENOMEM;
+		goto exit;
+	}
+
+	atomic_store(&executor.stop, false);
+	ret = -pthread_create(&executor.thread, NULL, executor_main, NULL);
+	if (ret < 0) {
+		log_err("Failed to start executor: %s\n", strerror(-ret));
+		goto exit;
+	}
+
+	executor.running = true;
+	return 0;
+exit:
+	executor_cleanup();
+	return ret;
+}
+
+/* queued requests are dropped, the connection is the caller's again */
+void executor_stop(void)
+{
+	if (!executor.running)
+		return;
+
+	atomic_store_explicit(&executor.stop, true, memory_order_release);
+	executor_wake(executor.request_fd);
+	pthread_join(executor.thread, NULL);
+	executor.running = false;
+
+	executor_cleanup();
+}
+
+bool executor_running(void)
+{
+	return executor.running;
+}
@@ -0,0 +1,37 @@
+#ifndef _EXECUTOR_H_
+#define _EXECUTOR_H_
+
+#include <stdbool.h>
+
+#include "connection.h"
+
+/* requests and replies in flight between the threads, power of two */
+#define EXECUTOR_QUEUE_SIZE	64
+
+struct action;
+struct latency_trace;
+
+/*
+ * Optional thread owning the sway connection, the command queue and the
+ * workspace cache. The input thread hands actions over through a
+ * single-producer single-consumer ring and never waits on sway nor
+ * allocates to do so. Replies to executor_run() come back through a
+ * second ring and their callbacks run on the input thread.
+ */
+int executor_start(struct connection *conn);
+void executor_stop(void);
+bool executor_running(void);
+
+/* input thread side, -EAGAIN when the ring is full */
+int executor_execute(const struct action *action,
+		     const struct latency_trace *trace);
+int executor_run(const char *cmd, connection_reply_cb cb, void *data);
+
+/* readable when replies are waiting for executor_complete() */
+int executor_get_fd(void);
+void executor_complete(void);
+
+/* log the queue depth */
+void executor_dump(void);
+
+#endif
@@ -1,14 +1,17 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <syslog.h>
+#include <string.h>
 
+#include "binding.h"
 #include "gesture.h"
+#include "latency.h"
+#include "log.h"
 
-enum gesture_type {
-	HOLD,
-	PINCH,
-	SWIPE
-};
+_Static_assert(sizeof(struct gesture_event) == 64,
+	       "gesture events are recorded as is");
 
 struct gesture {
 	/*
@@ -19,35 +22,67 @@ struct gesture {
 	 */
 	enum gesture_type type;
 	struct gesture_ops *ops;
-	const void *data;
+	bool used;
+	/* per type state, see gesture_get_data() */
+	union {
+		max_align_t align;
+		unsigned char bytes[GESTURE_DATA_SIZE];
+	} data;
 };
 
-struct gesture *gesture_new(struct libinput_event_gesture *li_gesture)
+/* gestures are taken from a fixed pool, BEGIN to END never allocates */
+static struct gesture gesture_pool[GESTURE_POOL_SIZE];
+
+static struct gesture *gesture_alloc(void)
+{
+	struct gesture *gest;
+	int i;
+
+	for (i = 0; i < GESTURE_POOL_SIZE; i++) {
+		gest = &gesture_pool[i];
+		if (gest->used)
+			continue;
+
+		gest->type = GESTURE_HOLD;
+		gest->ops = NULL;
+		gest->used = true;
+		memset(&gest->data, 0, sizeof(gest->data));
+		return gest;
+	}
+
+	return NULL;
+}
+
+struct gesture *gesture_new(const struct gesture_event *event)
 {
 	struct gesture *gest;
 	int ret = 0;
 
-	gest = calloc(1, sizeof(*gest));
-	if (!gest)
+	gest = gesture_alloc();
+	if (!gest) {
+		log_err("No free gesture slot\n");
 		goto exit;
+	}
 
-	switch (libinput_event_get_type(
-			libinput_event_gesture_get_base_event(li_gesture))) {
+	switch (event->type) {
 
-	case LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN:
-		syslog(LOG_DEBUG, "%s: swipe BEGIN\n", __func__);
-		gest->type = SWIPE;
-		gest->ops = swipe_get_ops();
+	case GESTURE_SWIPE:
+		log_debug("%s: swipe BEGIN\n", __func__);
+		gest->type = GESTURE_SWIPE;
+		/* strokes with corners, decided on END only */
+		gest->ops = binding_has_shapes(event->nfingers) ?
+			    shape_get_ops() : swipe_get_ops();
 		break;
 
-	case LIBINPUT_EVENT_GESTURE_PINCH_BEGIN:
-		syslog(LOG_DEBUG, "%s: pinch BEGIN\n", __func__);
-		gest->type = PINCH;
+	case GESTURE_PINCH:
+		log_debug("%s: pinch BEGIN\n", __func__);
+		gest->type = GESTURE_PINCH;
+		gest->ops = pinch_get_ops();
 		break;
 
-	case LIBINPUT_EVENT_GESTURE_HOLD_BEGIN:
-		syslog(LOG_DEBUG, "%s: hold BEGIN\n", __func__);
-		gest->type = HOLD;
+	case GESTURE_HOLD:
+		log_debug("%s: hold BEGIN\n", __func__);
+		gest->type = GESTURE_HOLD;
 		break;
 
 	default:
@@ -55,20 +90,19 @@ struct gesture *gesture_new(struct libinput_event_gesture *li_gesture)
 	};
 
 	if (gest->ops && gest->ops->begin)
-		ret = gest->ops->begin(gest, li_gesture);
+		ret = gest->ops->begin(gest, event);
 	if (ret < 0) {
-		syslog(LOG_ERR, "Failed to execute gesture BEGIN operation\n");
+		log_err("Failed to execute gesture BEGIN operation\n");
 		goto exit;
 	}
 
 	return gest;
 exit:
-	gesture_destroy(gest, li_gesture);
+	gesture_destroy(gest, event);
 	return NULL;
 }
 
-void gesture_destroy(struct gesture *gest,
-		     struct libinput_event_gesture *li_gesture)
+void gesture_destroy(struct gesture *gest, const struct gesture_event *event)
 {
 	int ret = 0;
 
@@ -76,40 +110,39 @@ void gesture_destroy(struct gesture *gest,
 		return;
 
 	if (gest->ops && gest->ops->end)
-		ret = gest->ops->end(gest, li_gesture);
+		ret = gest->ops->end(gest, event);
 	if (ret < 0)
-		syslog(LOG_ERR, "Failed to execute gesture END operation\n");
+		log_err("Failed to execute gesture END operation\n");
 
 	switch (gest->type) {
 
-	case SWIPE:
-		syslog(LOG_DEBUG, "%s: swipe END\n", __func__);
+	case GESTURE_SWIPE:
+		log_debug("%s: swipe END\n", __func__);
 		break;
 
-	case PINCH:
-		syslog(LOG_DEBUG, "%s: pinch END\n", __func__);
+	case GESTURE_PINCH:
+		log_debug("%s: pinch END\n", __func__);
 		break;
 
-	case HOLD:
-		syslog(LOG_DEBUG, "%s: hold END\n", __func__);
+	case GESTURE_HOLD:
+		log_debug("%s: hold END\n", __func__);
 		break;
 
 	default:
 		break;
 	};
 
-	free(gest);
+	gest->used = false;
 }
 
-int gesture_update(struct gesture *gest,
-		   struct libinput_event_gesture *li_gesture)
+int gesture_update(struct gesture *gest, const struct gesture_event *event)
 {
 	int ret = 0;
 
 	if (gest->ops && gest->ops->update)
-		ret = gest->ops->update(gest, li_gesture);
+		ret = gest->ops->update(gest, event);
 	if (ret < 0) {
-		syslog(LOG_ERR, "Failed to execute gesture UPDATE operation\n");
+		log_err("Failed to execute gesture UPDATE operation\n");
 		goto exit;
 	}
 
@@ -117,12 +150,55 @@ exit:
 	return ret;
 }
 
-void gesture_set_data(struct gesture *gest, const void *data)
+void *gesture_get_data(struct gesture *gest)
+{
+	return gest ? gest->data.bytes : NULL;
+}
+
+bool gesture_cancelled(const struct gesture_event *event)
 {
-	gest->data = data;
+	/* interrupted by another gesture or by shutdown */
+	if (!event || event->phase != GESTURE_END)
+		return true;
+
+	return event->cancelled;
 }
 
-const void *gesture_get_data(struct gesture *gest)
+int gesture_dispatch(struct gesture **gest, const struct gesture_event *event)
 {
-	return gest ? gest->data : NULL;
+	int ret = 0;
+
+	latency_event(event->time_usec);
+
+	switch (event->phase) {
+	case GESTURE_BEGIN:
+		if (*gest) {
+			log_err("Cancelling ongoing gesture\n");
+			gesture_destroy(*gest, event);
+		}
+		*gest = gesture_new(event);
+		if (!*gest)
+			ret = -ENOMEM;
+		break;
+
+	case GESTURE_UPDATE:
+		if (!*gest) {
+			log_err("Missing ongoing gesture to update\n");
+			break;
+		}
+		ret = gesture_update(*gest, event);
+		break;
+
+	case GESTURE_END:
+		if (!*gest)
+			log_err("Missing ongoing gesture to end\n");
+		gesture_destroy(*gest, event);
+		*gest = NULL;
+		break;
+
+	default:
+		break;
+	};
+
+	return ret;
 }
@@ -1,30 +1,83 @@
 #ifndef _GESTURE_H_
 #define _GESTURE_H_
 
-#include <libinput.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* at most one gesture per device is active at a time */
+#define GESTURE_POOL_SIZE	8
+/* room for the state of any gesture type */
+#define GESTURE_DATA_SIZE	768
+/* travel for a swipe to fire its direction binding */
+#define SWIPE_DIST_THRESHOLD	100.0
+
+enum gesture_type {
+	GESTURE_HOLD,
+	GESTURE_PINCH,
+	GESTURE_SWIPE,
+	GESTURE_TYPE_COUNT
+};
+
+enum gesture_phase {
+	GESTURE_BEGIN,
+	GESTURE_UPDATE,
+	GESTURE_END
+};
+
+/*
+ * libinput gesture event, copied out so that recognizers can be fed from
+ * a recording without libinput. Fields not provided by an event are 0.
+ */
+struct gesture_event {
+	uint64_t time_usec;
+	double dx;
+	double dy;
+	double dx_unaccel;
+	double dy_unaccel;
+	double scale;
+	double angle;
+	/* enum gesture_type */
+	uint8_t type;
+	/* enum gesture_phase */
+	uint8_t phase;
+	uint8_t nfingers;
+	uint8_t cancelled;
+	/* gestures of different devices are tracked independently */
+	uint8_t device;
+	uint8_t reserved[3];
+};
 
 struct gesture;
 
-struct gesture *gesture_new(struct libinput_event_gesture *li_gesture);
-void gesture_destroy(struct gesture *gest,
-		     struct libinput_event_gesture *li_gesture);
-int gesture_update(struct gesture *gest,
-		   struct libinput_event_gesture *li_gesture);
+struct gesture *gesture_new(const struct gesture_event *event);
+void gesture_destroy(struct gesture *gest, const struct gesture_event *event);
+int gesture_update(struct gesture *gest, const struct gesture_event *event);
+
+/*
+ * Feed an event to the ongoing gesture *gest, started on BEGIN and reset
+ * to NULL on END.
+ */
+int gesture_dispatch(struct gesture **gest, const struct gesture_event *event);
 
-void gesture_set_data(struct gesture *gest, const void *data);
-const void *gesture_get_data(struct gesture *gest);
+/* zeroed storage of GESTURE_DATA_SIZE bytes for the gesture type state */
+void *gesture_get_data(struct gesture *gest);
+
+/* true unless event is an END event of a completed gesture */
+bool gesture_cancelled(const struct gesture_event *event);
 
 /* gestures operations */
 struct gesture_ops {
-	int (*begin)(struct gesture *gest,
-		     struct libinput_event_gesture *li_gesture);
-	int (*update)(struct gesture *gest,
-		      struct libinput_event_gesture *li_gesture);
-	int (*end)(struct gesture *gest,
-		   struct libinput_event_gesture *li_gesture);
+	int (*begin)(struct gesture *gest, const struct gesture_event *event);
+	int (*update)(struct gesture *gest, const struct gesture_event *event);
+	int (*end)(struct gesture *gest, const struct gesture_event *event);
 };
 
 /* export gestures operations */
+struct gesture_ops *pinch_get_ops(void);
+struct gesture_ops *shape_get_ops(void);
 struct gesture_ops *swipe_get_ops(void);
 
+/* fire swipe actions during UPDATE once the direction is locked */
+void swipe_set_early_commit(bool enable);
+
 #endif
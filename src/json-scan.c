@@ -0,0 +1,233 @@
+#include <limits.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "json-scan.h"
+
+static const char *skip_ws(const char *p, const char *end)
+{
+	while (p < end && (*p == ' ' || *p == '\t' ||
+			   *p == '\n' || *p == '\r'))
+		p++;
+
+	return p;
+}
+
+/* p points to the opening quote, returns past the closing one */
+static const char *skip_string(const char *p, const char *end)
+{
+	for (p++; p < end; p++) {
+		if (*p == '\\')
+			p++;
+		else if (*p == '"')
+			return p + 1;
+	}
+
+	return NULL;
+}
+
+static const char *skip_value(const char *p, const char *end)
+{
+	const char *start = p;
+	int depth = 0;
+
+	if (p >= end)
+		return NULL;
+
+	switch (*p) {
+	case '"':
+		return skip_string(p, end);
+
+	case '{':
+	case '[':
+		while (p < end) {
+			switch (*p) {
+			case '"':
+				p = skip_string(p, end);
+				if (!p)
+					return NULL;
+				continue;
+			case '{':
+			case '[':
+				depth++;
+				break;
+			case '}':
+			case ']':
+				if (--depth == 0)
+					return p + 1;
+				break;
+			default:
+				break;
+			}
+			p++;
+		}
+		return NULL;
+
+	default:
+		/* number or literal, up to the next delimiter */
+		while (p < end && !strchr(",}] \t\r\n", *p))
+			p++;
+		return p > start ? p : NULL;
+	}
+}
+
+static void span_init(struct json_span *span, const char *start,
+		      const char *end)
+{
+	span->start = start;
+	span->len = end - start;
+}
+
+bool json_scan_array(struct json_scan *it, const struct json_span *array)
+{
+	const char *end = array->start + array->len;
+	const char *p = skip_ws(array->start, end);
+
+	if (p >= end || *p != '[')
+		return false;
+
+	it->pos = p + 1;
+	it->end = end;
+	return true;
+}
+
+bool json_scan_array_next(struct json_scan *it, struct json_span *elem)
+{
+	const char *p = skip_ws(it->pos, it->end);
+	const char *next;
+
+	if (p < it->end && *p == ',')
+		p = skip_ws(p + 1, it->end);
+
+	if (p >= it->end || *p == ']')
+		return false;
+
+	next = skip_value(p, it->end);
+	if (!next)
+		return false;
+
+	span_init(elem, p, next);
+	it->pos = next;
+	return true;
+}
+
+bool json_scan_get(const struct json_span *obj, const char *key,
+		   struct json_span *value)
+{
+	const char *end = obj->start + obj->len;
+	const char *p = skip_ws(obj->start, end);
+	const char *key_start, *key_end, *next;
+	size_t key_len = strlen(key);
+
+	if (p >= end || *p != '{')
+		return false;
+	p++;
+
+	for (;;) {
+		p = skip_ws(p, end);
+		if (p >= end || *p != '"')
+			return false;
+
+		key_start = p + 1;
+		p = skip_string(p, end);
+		if (!p)
+			return false;
+		key_end = p - 1;
+
+		p = skip_ws(p, end);
+		if (p >= end || *p != ':')
+			return false;
+		p = skip_ws(p + 1, end);
+
+		next = skip_value(p, end);
+		if (!next)
+			return false;
+
+		if ((size_t)(key_end - key_start) == key_len &&
+		    !memcmp(key_start, key, key_len)) {
+			span_init(value, p, next);
+			return true;
+		}
+
+		p = skip_ws(next, end);
+		if (p >= end || *p != ',')
+			return false;
+		p++;
+	}
+}
+
+bool json_scan_int(const struct json_span *value, int *out)
+{
+	const char *p = value->start;
+	const char *end = value->start + value->len;
+	bool negative = false;
+	long long num = 0;
+
+	if (p < end && *p == '-') {
+		negative = true;
+		p++;
+	}
+
+	if (p >= end)
+		return false;
+
+	for (; p < end; p++) {
+		if (*p < '0' || *p > '9')
+			return false;
+		num = num * 10 + (*p - '0');
+		if (num > INT_MAX)
+			return false;
+	}
+
+	*out = negative ? -num : num;
+	return true;
+}
+
+bool json_scan_bool(const struct json_span *value, bool *out)
+{
+	if (value->len == 4 && !memcmp(value->start, "true", 4)) {
+		*out = true;
+		return true;
+	}
+
+	if (value->len == 5 && !memcmp(value->start, "false", 5)) {
+		*out = false;
+		return true;
+	}
+
+	return false;
+}
+
+bool json_scan_string(const struct json_span *value, struct json_span *str)
+{
+	if (value->len < 2 || value->start[0] != '"')
+		return false;
+
+	str->start = value->start + 1;
+	str->len = value->len - 2;
+	return true;
+}
+
+bool json_scan_string_eq(const struct json_span *value, const char *str)
+{
+	struct json_span raw;
+
+	return json_scan_string(value, &raw) && raw.len == strlen(str) &&
+	       !memcmp(raw.start, str, raw.len);
+}
+
+bool json_scan_get_int(const struct json_span *obj, const char *key,
+		       int *out)
+{
+	struct json_span value;
+
+	return json_scan_get(obj, key, &value) && json_scan_int(&value, out);
+}
+
+bool json_scan_get_bool(const struct json_span *obj, const char *key,
+			bool *out)
+{
+	struct json_span value;
+
+	return json_scan_get(obj, key, &value) && json_scan_bool(&value, out);
+}
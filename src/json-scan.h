@@ -0,0 +1,45 @@
+#ifndef _JSON_SCAN_H_
+#define _JSON_SCAN_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Minimal JSON scanner working in place on sway replies: values are
+ * located as spans of the input buffer, nothing is copied nor allocated.
+ * Only what swayped reads out of sway messages is supported: keys and
+ * compared strings are matched raw, without unescaping.
+ */
+
+/* a JSON value, pointing into the scanned buffer */
+struct json_span {
+	const char *start;
+	size_t len;
+};
+
+/* array iterator */
+struct json_scan {
+	const char *pos;
+	const char *end;
+};
+
+bool json_scan_array(struct json_scan *it, const struct json_span *array);
+bool json_scan_array_next(struct json_scan *it, struct json_span *elem);
+
+/* look up a member of an object, nested objects are skipped */
+bool json_scan_get(const struct json_span *obj, const char *key,
+		   struct json_span *value);
+
+/* typed accessors, false when the value has another type */
+bool json_scan_int(const struct json_span *value, int *out);
+bool json_scan_bool(const struct json_span *value, bool *out);
+bool json_scan_string(const struct json_span *value, struct json_span *str);
+bool json_scan_string_eq(const struct json_span *value, const char *str);
+
+/* shortcuts for object members */
+bool json_scan_get_int(const struct json_span *obj, const char *key,
+		       int *out);
+bool json_scan_get_bool(const struct json_span *obj, const char *key,
+			bool *out);
+
+#endif
@@ -0,0 +1,200 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "binding.h"
+#include "latency.h"
+#include "log.h"
+
+/*
+ * Time spent reaching each stage from the previous one, total at 0. With
+ * the executor thread, replies are recorded from both threads.
+ */
+struct histogram {
+	_Atomic uint64_t count;
+	_Atomic uint64_t max;
+	_Atomic uint32_t buckets[LATENCY_BUCKETS];
+};
+
+static const char * const action_str[] = {
+	[ACTION_NONE]                     = "none",
+	[ACTION_WORKSPACE_NEXT]           = "workspace_next",
+	[ACTION_WORKSPACE_PREV]           = "workspace_prev",
+	[ACTION_WORKSPACE_BACK_AND_FORTH] = "workspace_back_and_forth",
+	[ACTION_WORKSPACE_NEW]            = "new_workspace",
+	[ACTION_WORKSPACE_NEW_LOWEST]     = "new_workspace_lowest",
+	[ACTION_COMMAND]                  = "command",
+	[ACTION_SPAWN]                    = "spawn",
+	[ACTION_CONTINUOUS]               = "continuous",
+};
+
+/* named after the stage the interval ends at */
+static const char * const interval_str[] = {
+	[LATENCY_EVENT]     = "total",
+	[LATENCY_DEQUEUE]   = "libinput",
+	[LATENCY_RECOGNIZE] = "recognize",
+	[LATENCY_WRITE]     = "queue",
+	[LATENCY_REPLY]     = "sway",
+};
+
+static struct histogram histograms[ACTION_TYPE_COUNT][LATENCY_STAGE_COUNT];
+static struct latency_trace current;
+
+static uint64_t latency_clock_monotonic(void)
+{
+	struct timespec ts;
+
+	/* same clock as libinput event timestamps */
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t (*latency_clock)(void) = latency_clock_monotonic;
+
+static unsigned int bucket_index(uint64_t usec)
+{
+	unsigned int exp;
+
+	if (usec < (1 << (LATENCY_SUB_BITS + 1)))
+		return usec;
+
+	exp = 63 - __builtin_clzll(usec);
+	if (exp > LATENCY_MAX_EXP)
+		return LATENCY_BUCKETS - 1;
+
+	/* leading bit is implicit, keep the next LATENCY_SUB_BITS */
+	return ((exp - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS) +
+	       ((usec >> (exp - LATENCY_SUB_BITS)) &
+		((1 << LATENCY_SUB_BITS) - 1));
+}
+
+/* highest value falling in a bucket */
+static uint64_t bucket_value(unsigned int index)
+{
+	unsigned int exp, sub;
+
+	if (index < (1 << (LATENCY_SUB_BITS + 1)))
+		return index;
+
+	exp = (index >> LATENCY_SUB_BITS) + LATENCY_SUB_BITS - 1;
+	sub = index & ((1 << LATENCY_SUB_BITS) - 1);
+	return ((uint64_t)((1 << LATENCY_SUB_BITS) + sub + 1) <<
+		(exp - LATENCY_SUB_BITS)) - 1;
+}
+
+static void histogram_add(struct histogram *histogram, uint64_t usec)
+{
+	uint64_t max = atomic_load_explicit(&histogram->max,
+					    memory_order_relaxed);
+
+	atomic_fetch_add_explicit(&histogram->buckets[bucket_index(usec)], 1,
+				  memory_order_relaxed);
+	atomic_fetch_add_explicit(&histogram->count, 1, memory_order_relaxed);
+	while (usec > max &&
+	       !atomic_compare_exchange_weak_explicit(&histogram->max, &max,
+						      usec,
+						      memory_order_relaxed,
+						      memory_order_relaxed))
+		;
+}
+
+static uint64_t histogram_percentile(const struct histogram *histogram,
+				     unsigned int percent)
+{
+	uint64_t rank = (histogram->count * percent + 99) / 100;
+	uint64_t seen = 0;
+	unsigned int i;
+
+	for (i = 0; i < LATENCY_BUCKETS; i++) {
+		seen += histogram->buckets[i];
+		if (seen >= rank && seen > 0)
+			break;
+	}
+
+	/* the bucket bound may overshoot the largest value seen */
+	return i < LATENCY_BUCKETS && bucket_value(i) < histogram->max ?
+	       bucket_value(i) : histogram->max;
+}
+
+uint64_t latency_now(void)
+{
+	return latency_clock();
+}
+
+void latency_set_clock(uint64_t (*clock)(void))
+{
+	latency_clock = clock ? clock : latency_clock_monotonic;
+}
+
+void latency_event(uint64_t event_usec)
+{
+	memset(&current, 0, sizeof(current));
+	current.usec[LATENCY_EVENT] = event_usec;
+	current.usec[LATENCY_DEQUEUE] = latency_now();
+}
+
+void latency_recognized(void)
+{
+	current.usec[LATENCY_RECOGNIZE] = latency_now();
+}
+
+const struct latency_trace *latency_current(void)
+{
+	return &current;
+}
+
+void latency_stamp(struct latency_trace *trace, enum latency_stage stage)
+{
+	trace->usec[stage] = latency_now();
+}
+
+void latency_record(const struct latency_trace *trace)
+{
+	struct histogram *histograms_action;
+	int stage;
+
+	if (trace->action <= ACTION_NONE || trace->action >= ACTION_TYPE_COUNT)
+		return;
+
+	/* actions not triggered by a gesture event, e.g. a drained throttle */
+	for (stage = 0; stage < LATENCY_STAGE_COUNT; stage++)
+		if (!trace->usec[stage])
+			return;
+
+	histograms_action = histograms[trace->action];
+	for (stage = LATENCY_DEQUEUE; stage < LATENCY_STAGE_COUNT; stage++)
+		histogram_add(&histograms_action[stage],
+			      trace->usec[stage] - trace->usec[stage - 1]);
+
+	histogram_add(&histograms_action[LATENCY_EVENT],
+		      trace->usec[LATENCY_REPLY] - trace->usec[LATENCY_EVENT]);
+}
+
+void latency_dump(void)
+{
+	const struct histogram *histogram;
+	bool empty = true;
+	int action, stage;
+
+	for (action = 0; action < ACTION_TYPE_COUNT; action++) {
+		for (stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+			histogram = &histograms[action][stage];
+			if (!histogram->count)
+				continue;
+
+			empty = false;
+			log_info("latency %s %s: count %llu p50 %lluus "
+				 "p90 %lluus p99 %lluus max %lluus\n",
+				 action_str[action], interval_str[stage],
+				 (unsigned long long)histogram->count,
+				 (unsigned long long)histogram_percentile(histogram, 50),
+				 (unsigned long long)histogram_percentile(histogram, 90),
+				 (unsigned long long)histogram_percentile(histogram, 99),
+				 (unsigned long long)histogram->max);
+		}
+	}
+
+	if (empty)
+		log_info("latency: no action recorded yet\n");
+}
@@ -0,0 +1,52 @@
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+
+#include <stdint.h>
+
+/* log-linear buckets: 8 per power of two, 12.5% resolution */
+#define LATENCY_SUB_BITS	3
+/* values up to 2^LATENCY_MAX_EXP usec, larger ones are clamped */
+#define LATENCY_MAX_EXP		32
+#define LATENCY_BUCKETS		((LATENCY_MAX_EXP - LATENCY_SUB_BITS + 2) << \
+				 LATENCY_SUB_BITS)
+
+/* points a gesture goes through on its way to a sway action */
+enum latency_stage {
+	/* libinput event timestamp */
+	LATENCY_EVENT,
+	/* event dequeued from libinput */
+	LATENCY_DEQUEUE,
+	/* action picked by a recognizer */
+	LATENCY_RECOGNIZE,
+	/* command written to sway */
+	LATENCY_WRITE,
+	/* sway replied */
+	LATENCY_REPLY,
+	LATENCY_STAGE_COUNT
+};
+
+/* travels with the action, stamps are CLOCK_MONOTONIC usec, 0 if unset */
+struct latency_trace {
+	int action;
+	uint64_t usec[LATENCY_STAGE_COUNT];
+};
+
+/* clock of the daemon, replays drive it from recorded timestamps */
+uint64_t latency_now(void);
+void latency_set_clock(uint64_t (*clock)(void));
+
+/* start the trace of the libinput event being processed */
+void latency_event(uint64_t event_usec);
+void latency_recognized(void);
+/* trace of the event being processed, copied by whoever acts on it */
+const struct latency_trace *latency_current(void);
+
+void latency_stamp(struct latency_trace *trace, enum latency_stage stage);
+
+/* account a trace completed with its reply in the histograms of its action */
+void latency_record(const struct latency_trace *trace);
+
+/* log percentiles of every histogram */
+void latency_dump(void);
+
+#endif
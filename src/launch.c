@@ -0,0 +1,58 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+
+#include "binding.h"
+#include "launch.h"
+#include "log.h"
+
+extern char **environ;
+
+int launch_action(const struct action *action)
+{
+	/* every word takes at least its NUL */
+	char *argv[BINDING_COMMAND_SIZE + 1];
+	const char *word = action->command;
+	posix_spawnattr_t attr;
+	sigset_t mask;
+	unsigned int i;
+	pid_t pid;
+	int ret;
+
+	for (i = 0; i < action->argc; i++) {
+		argv[i] = (char *)word;
+		word += strlen(word) + 1;
+	}
+	argv[i] = NULL;
+
+	ret = posix_spawnattr_init(&attr);
+	if (ret) {
+		log_err("Failed to init spawn attributes: %s\n",
+			strerror(ret));
+		return -ret;
+	}
+
+	/*
+	 * The signals we handle through a signalfd are blocked, the
+	 * program gets a clean mask. Its own process group keeps it
+	 * running when ours is interrupted from a terminal.
+	 */
+	sigemptyset(&mask);
+	posix_spawnattr_setsigmask(&attr, &mask);
+	posix_spawnattr_setpgroup(&attr, 0);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK |
+				 POSIX_SPAWN_SETPGROUP);
+
+	/* vfork semantics, nothing of the daemon is copied */
+	ret = posix_spawnp(&pid, argv[0], NULL, &attr, argv, environ);
+	posix_spawnattr_destroy(&attr);
+	if (ret) {
+		log_err("Failed to spawn %s: %s\n", argv[0], strerror(ret));
+		return -ret;
+	}
+
+	log_debug("%s: %s started as %d\n", __func__, argv[0], (int)pid);
+	return 0;
+}
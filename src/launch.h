@@ -0,0 +1,12 @@
+#ifndef _LAUNCH_H_
+#define _LAUNCH_H_
+
+struct action;
+
+/*
+ * Start the program of an ACTION_SPAWN without waiting for it. The child
+ * is reaped by the kernel, see main().
+ */
+int launch_action(const struct action *action);
+
+#endif
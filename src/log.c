@@ -0,0 +1,108 @@
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "log.h"
+
+_Static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0,
+	       "LOG_RING_SIZE must be a power of two");
+
+/*
+ * Bounded multi-producer queue after Dmitry Vyukov's. The turn of a record
+ * tells the lap of the ring it is at: 2 * lap when free for producers,
+ * 2 * lap + 1 once written, so a zeroed ring is an empty one.
+ */
+struct log_record {
+	atomic_size_t turn;
+	int prio;
+	char msg[LOG_MSG_SIZE];
+};
+
+static struct {
+	struct log_record records[LOG_RING_SIZE];
+	/* next position to write, shared by producers */
+	atomic_size_t head;
+	/* next position to flush, owned by the consumer */
+	size_t tail;
+	atomic_uint dropped;
+} ring;
+
+int log_level = LOG_INFO;
+
+static size_t log_turn(size_t pos)
+{
+	return pos / LOG_RING_SIZE * 2;
+}
+
+void log_set_level(int level)
+{
+	log_level = level;
+}
+
+void log_vwrite(int prio, const char *fmt, va_list args)
+{
+	struct log_record *record;
+	size_t pos, turn;
+	ptrdiff_t diff;
+
+	pos = atomic_load_explicit(&ring.head, memory_order_relaxed);
+	for (;;) {
+		record = &ring.records[pos % LOG_RING_SIZE];
+		turn = atomic_load_explicit(&record->turn,
+					    memory_order_acquire);
+		diff = (ptrdiff_t)(turn - log_turn(pos));
+
+		if (diff == 0) {
+			if (atomic_compare_exchange_weak_explicit(&ring.head,
+					&pos, pos + 1, memory_order_relaxed,
+					memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			/* not flushed since the previous lap */
+			atomic_fetch_add_explicit(&ring.dropped, 1,
+						  memory_order_relaxed);
+			return;
+		} else {
+			pos = atomic_load_explicit(&ring.head,
+						   memory_order_relaxed);
+		}
+	}
+
+	record->prio = prio;
+	vsnprintf(record->msg, sizeof(record->msg), fmt, args);
+	atomic_store_explicit(&record->turn, log_turn(pos) + 1,
+			      memory_order_release);
+}
+
+void log_write(int prio, const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	log_vwrite(prio, fmt, args);
+	va_end(args);
+}
+
+void log_flush(void)
+{
+	struct log_record *record;
+	unsigned int dropped;
+
+	for (;;) {
+		record = &ring.records[ring.tail % LOG_RING_SIZE];
+		if (atomic_load_explicit(&record->turn, memory_order_acquire) !=
+		    log_turn(ring.tail) + 1)
+			break;
+
+		syslog(record->prio, "%s", record->msg);
+		atomic_store_explicit(&record->turn, log_turn(ring.tail) + 2,
+				      memory_order_release);
+		ring.tail++;
+	}
+
+	dropped = atomic_exchange_explicit(&ring.dropped, 0,
+					   memory_order_relaxed);
+	if (dropped)
+		syslog(LOG_ERR, "%u log records dropped\n", dropped);
+}
@@ -0,0 +1,42 @@
+#ifndef _LOG_H_
+#define _LOG_H_
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <syslog.h>
+
+/* records buffered between two flushes, power of two */
+#define LOG_RING_SIZE	256
+#define LOG_MSG_SIZE	240
+
+/* syslog priority of the least important record kept */
+extern int log_level;
+
+void log_set_level(int level);
+
+/*
+ * Records are formatted into a lock-free ring and only written to syslog
+ * by log_flush(). When the ring is full records are dropped and counted.
+ */
+void log_write(int prio, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+void log_vwrite(int prio, const char *fmt, va_list args)
+	__attribute__((format(printf, 2, 0)));
+
+/* write out buffered records, single consumer: call from the main loop */
+void log_flush(void);
+
+#define log_enabled(prio)	((prio) <= log_level)
+
+/* arguments are not evaluated when the level is disabled */
+#define log_msg(prio, ...)					\
+	do {							\
+		if (log_enabled(prio))				\
+			log_write(prio, __VA_ARGS__);		\
+	} while (0)
+
+#define log_err(...)	log_msg(LOG_ERR, __VA_ARGS__)
+#define log_info(...)	log_msg(LOG_INFO, __VA_ARGS__)
+#define log_debug(...)	log_msg(LOG_DEBUG, __VA_ARGS__)
+
+#endif
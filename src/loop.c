@@ -0,0 +1,310 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include "log.h"
+#include "loop.h"
+
+struct loop_source {
+	int fd;
+	uint32_t events;
+	loop_fd_cb cb;
+	void *data;
+	bool used;
+	/* of the batch being dispatched */
+	uint32_t revents;
+};
+
+struct loop {
+	int epfd;
+
+	/* in order of addition, the timerfd one is not part of it */
+	struct loop_source sources[LOOP_MAX_SOURCES];
+
+	int timerfd;
+	/* armed timers, earliest deadline first */
+	struct loop_timer *timers;
+	/* deadline the timerfd is set to, 0 when unset */
+	uint64_t timerfd_usec;
+};
+
+uint64_t loop_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void loop_set_timerfd(struct loop *loop, uint64_t deadline_usec)
+{
+	struct itimerspec its = { 0 };
+
+	its.it_value.tv_sec = deadline_usec / 1000000;
+	its.it_value.tv_nsec = deadline_usec % 1000000 * 1000;
+	if (timerfd_settime(loop->timerfd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+		log_err("Failed to set timer: %s\n", strerror(errno));
+		return;
+	}
+
+	loop->timerfd_usec = deadline_usec;
+}
+
+/*
+ * Deadlines pushed back, e.g. a timeout restarted on every input event,
+ * leave the timerfd as is: it fires early once and is set again then,
+ * rather than costing a syscall per event.
+ */
+static void loop_program(struct loop *loop)
+{
+	uint64_t deadline_usec = loop->timers ? loop->timers->deadline_usec : 0;
+
+	if (!deadline_usec)
+		return;
+
+	if (!loop->timerfd_usec || deadline_usec < loop->timerfd_usec)
+		loop_set_timerfd(loop, deadline_usec);
+}
+
+static void loop_expire(struct loop *loop)
+{
+	struct loop_timer *timer;
+	uint64_t expirations, now_usec;
+
+	if (read(loop->timerfd, &expirations, sizeof(expirations)) < 0 &&
+	    errno != EAGAIN)
+		log_err("Failed to read timer: %s\n", strerror(errno));
+	loop->timerfd_usec = 0;
+
+	now_usec = loop_now();
+	while (loop->timers && loop->timers->deadline_usec <= now_usec) {
+		timer = loop->timers;
+		loop->timers = timer->next;
+		timer->next = NULL;
+		timer->deadline_usec = 0;
+
+		/* may arm timers again, including this one */
+		timer->cb(timer->data);
+	}
+
+	loop_program(loop);
+}
+
+struct loop *loop_new(void)
+{
+	struct epoll_event ev = { .events = EPOLLIN };
+	struct loop *loop;
+
+	loop = calloc(1, sizeof(*loop));
+	if (!loop)
+		return NULL;
+	loop->timerfd = -1;
+
+	loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (loop->epfd < 0) {
+		log_err("Failed to create epoll instance: %s\n",
+			strerror(errno));
+		goto exit;
+	}
+
+	loop->timerfd = timerfd_create(CLOCK_MONOTONIC,
+				       TFD_NONBLOCK | TFD_CLOEXEC);
+	if (loop->timerfd < 0) {
+		log_err("Failed to create timer: %s\n", strerror(errno));
+		goto exit;
+	}
+
+	/* told apart from the sources by its NULL pointer */
+	ev.data.ptr = NULL;
+	if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->timerfd, &ev) < 0) {
+		log_err("Failed to watch timer: %s\n", strerror(errno));
+		goto exit;
+	}
+
+	return loop;
+exit:
+	loop_destroy(loop);
+	return NULL;
+}
+
+void loop_destroy(struct loop *loop)
+{
+	if (!loop)
+		return;
+
+	if (loop->timerfd >= 0)
+		close(loop->timerfd);
+	if (loop->epfd >= 0)
+		close(loop->epfd);
+	free(loop);
+}
+
+struct loop_source *loop_add(struct loop *loop, int fd, uint32_t events,
+			     loop_fd_cb cb, void *data)
+{
+	struct loop_source *source;
+	int i;
+
+	for (i = 0; i < LOOP_MAX_SOURCES; i++) {
+		source = &loop->sources[i];
+		if (source->used)
+			continue;
+
+		source->fd = -1;
+		source->events = 0;
+		source->cb = cb;
+		source->data = data;
+		source->revents = 0;
+		source->used = true;
+
+		if (loop_update(loop, source, fd, events) < 0) {
+			source->used = false;
+			return NULL;
+		}
+		return source;
+	}
+
+	log_err("No free loop source\n");
+	return NULL;
+}
+
+int loop_update(struct loop *loop, struct loop_source *source, int fd,
+		uint32_t events)
+{
+	struct epoll_event ev = { .events = events, .data.ptr = source };
+	int ret;
+
+	/* closing an fd drops it from the epoll set, errors are expected */
+	if (source->fd >= 0 && source->fd != fd)
+		epoll_ctl(loop->epfd, EPOLL_CTL_DEL, source->fd, NULL);
+
+	source->fd = fd;
+	source->events = events;
+	source->revents = 0;
+	if (fd < 0)
+		return 0;
+
+	/*
+	 * The fd may have been closed and another one opened under the same
+	 * number since the last update, let epoll tell whether it is known.
+	 */
+	ret = epoll_ctl(loop->epfd, EPOLL_CTL_MOD, fd, &ev);
+	if (ret < 0 && errno == ENOENT)
+		ret = epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev);
+	if (ret < 0) {
+		ret = -errno;
+		log_err("Failed to watch fd %d: %s\n", fd, strerror(-ret));
+		source->fd = -1;
+		return ret;
+	}
+
+	return 0;
+}
+
+void loop_remove(struct loop *loop, struct loop_source *source)
+{
+	if (!source)
+		return;
+
+	loop_update(loop, source, -1, 0);
+	source->used = false;
+}
+
+void loop_timer_init(struct loop_timer *timer, loop_timer_cb cb, void *data)
+{
+	timer->deadline_usec = 0;
+	timer->cb = cb;
+	timer->data = data;
+	timer->next = NULL;
+}
+
+void loop_timer_disarm(struct loop *loop, struct loop_timer *timer)
+{
+	struct loop_timer **link;
+
+	if (!timer->deadline_usec)
+		return;
+
+	for (link = &loop->timers; *link; link = &(*link)->next) {
+		if (*link == timer) {
+			*link = timer->next;
+			break;
+		}
+	}
+
+	timer->next = NULL;
+	timer->deadline_usec = 0;
+	/* an early wakeup is cheaper than resetting the timerfd */
+}
+
+void loop_timer_arm(struct loop *loop, struct loop_timer *timer,
+		    uint64_t deadline_usec)
+{
+	struct loop_timer **link;
+
+	loop_timer_disarm(loop, timer);
+
+	/* 0 means disarmed */
+	timer->deadline_usec = deadline_usec ? deadline_usec : 1;
+	for (link = &loop->timers; *link; link = &(*link)->next)
+		if ((*link)->deadline_usec > timer->deadline_usec)
+			break;
+
+	timer->next = *link;
+	*link = timer;
+
+	loop_program(loop);
+}
+
+int loop_dispatch(struct loop *loop)
+{
+	struct epoll_event events[LOOP_MAX_SOURCES + 1];
+	struct loop_source *source;
+	bool expired = false;
+	uint32_t revents;
+	int i, n;
+
+	do {
+		n = epoll_wait(loop->epfd, events, LOOP_MAX_SOURCES + 1, -1);
+	} while (n < 0 && errno == EINTR);
+
+	if (n < 0) {
+		n = -errno;
+		log_err("Failed to wait for events: %s\n", strerror(-n));
+		return n;
+	}
+
+	for (i = 0; i < n; i++) {
+		source = events[i].data.ptr;
+		if (source)
+			source->revents = events[i].events;
+		else
+			expired = true;
+	}
+
+	/*
+	 * Callbacks may update or remove sources, revents is reset then so
+	 * that events of a closed fd are not reported for its replacement.
+	 */
+	for (i = 0; i < LOOP_MAX_SOURCES; i++) {
+		source = &loop->sources[i];
+		if (!source->used || !source->revents)
+			continue;
+
+		revents = source->revents;
+		source->revents = 0;
+		source->cb(revents, source->data);
+	}
+
+	/* after input, so that an END that just came in disarms its timeout */
+	if (expired)
+		loop_expire(loop);
+
+	return 0;
+}
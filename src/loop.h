@@ -0,0 +1,52 @@
+#ifndef _LOOP_H_
+#define _LOOP_H_
+
+#include <stdint.h>
+
+/* fd sources of a loop, including the internal timer one */
+#define LOOP_MAX_SOURCES	8
+
+struct loop;
+struct loop_source;
+
+/* events and revents are EPOLL* flags, the same values as POLL* ones */
+typedef void (*loop_fd_cb)(uint32_t revents, void *data);
+typedef void (*loop_timer_cb)(void *data);
+
+/*
+ * One-shot deadline on CLOCK_MONOTONIC, the clock of libinput event
+ * timestamps. Timers are embedded in their owner and kept in deadline
+ * order, arming and disarming never allocates.
+ */
+struct loop_timer {
+	/* 0 while disarmed */
+	uint64_t deadline_usec;
+	loop_timer_cb cb;
+	void *data;
+	struct loop_timer *next;
+};
+
+struct loop *loop_new(void);
+void loop_destroy(struct loop *loop);
+
+/*
+ * Sources are dispatched in the order they were added. fd may be -1 for
+ * a source that is not active yet, see loop_update().
+ */
+struct loop_source *loop_add(struct loop *loop, int fd, uint32_t events,
+			     loop_fd_cb cb, void *data);
+int loop_update(struct loop *loop, struct loop_source *source, int fd,
+		uint32_t events);
+void loop_remove(struct loop *loop, struct loop_source *source);
+
+void loop_timer_init(struct loop_timer *timer, loop_timer_cb cb, void *data);
+void loop_timer_arm(struct loop *loop, struct loop_timer *timer,
+		    uint64_t deadline_usec);
+void loop_timer_disarm(struct loop *loop, struct loop_timer *timer);
+
+uint64_t loop_now(void);
+
+/* wait for and dispatch one batch of events, then the expired timers */
+int loop_dispatch(struct loop *loop);
+
+#endif
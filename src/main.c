@@ -1,26 +1,47 @@
 #include <errno.h>
 #include <fcntl.h>
-#include <poll.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <syslog.h>
 #include <unistd.h>
 
+#include <sys/epoll.h>
 #include <sys/signalfd.h>
 
 #include <libinput.h>
 
 #include <libudev.h>
 
+#include "binding.h"
+#include "command.h"
+#include "config-watch.h"
+#include "connection.h"
+#include "executor.h"
 #include "gesture.h"
-
-enum {
-	LIBINPUT_FD,
-	SIGNAL_FD,
-	NB_FDS
+#include "latency.h"
+#include "log.h"
+#include "loop.h"
+#include "record.h"
+#include "touchpad.h"
+#include "workspace.h"
+
+/* a gesture without events for that long lost its END, e.g. on suspend */
+#define GESTURE_TIMEOUT_USEC	5000000
+
+struct context;
+
+/* gesture in progress on a device, the slot index is the event device */
+struct device_gesture {
+	struct context *ctx;
+	/* NULL for a free slot, only compared */
+	struct libinput_device *device;
+	struct gesture *gesture;
+	/* cancels the gesture once stale */
+	struct loop_timer timer;
+	uint8_t type;
+	uint8_t nfingers;
 };
 
 struct context {
@@ -28,14 +49,41 @@ struct context {
 	int sigfd;
 	bool stop;
 
+	/* sources are dispatched in this order */
+	struct loop *loop;
+	struct loop_source *sway_source;
+	/* fails the sway requests once replies stop coming */
+	struct loop_timer sway_timer;
+	struct loop_source *executor_source;
+	struct loop_source *libinput_source;
+	struct loop_source *config_source;
+	struct loop_source *signal_source;
+	struct loop_source *touchpads_source;
+
 	/* libudev context */
 	struct udev *udev;
 
 	/* libinput context */
 	struct libinput *li;
+	/* -t, devices of the libinput path context */
+	struct touchpads *touchpads;
 
-	/* hold current gesture pointer */
-	struct gesture *gesture;
+	/* asynchronous sway IPC connection, -x hands it to the executor */
+	struct connection *conn;
+
+	/* gesture to action table */
+	struct bindings *bindings;
+	/* reloaded table waiting for the gesture in progress to end */
+	struct bindings *next_bindings;
+	struct config_watch *watch;
+	/* -e, overrides the configuration */
+	bool early_commit;
+
+	/* devices gesturing at once do not cancel each other */
+	struct device_gesture gestures[GESTURE_POOL_SIZE];
+
+	/* -r, gesture events are saved for swayped-replay */
+	struct recorder *recorder;
 };
 
 const char * const event_to_str[] = {
@@ -77,7 +125,8 @@ const char * const event_to_str[] = {
 
 static int open_restricted(const char *path, int flags, void *user_data)
 {
-	int fd = open(path, flags);
+	/* spawned programs must not inherit the devices */
+	int fd = open(path, flags | O_CLOEXEC);
 	return fd < 0 ? -errno : fd;
 }
 
@@ -93,45 +142,156 @@ const static struct libinput_interface interface = {
 
 static void context_destroy(struct context *ctx)
 {
+	int i;
+
 	if (!ctx)
 		return;
 
-	if (ctx->gesture)
-		gesture_destroy(ctx->gesture, NULL);
+	for (i = 0; i < GESTURE_POOL_SIZE; i++)
+		if (ctx->gestures[i].gesture)
+			gesture_destroy(ctx->gestures[i].gesture, NULL);
+	recorder_destroy(ctx->recorder);
 
+	/* holds device references */
+	touchpads_destroy(ctx->touchpads);
 	libinput_unref(ctx->li);
 	udev_unref(ctx->udev);
 
+	executor_stop();
+	connection_destroy(ctx->conn);
+
+	bindings_set(NULL);
+	bindings_destroy(ctx->bindings);
+	bindings_destroy(ctx->next_bindings);
+	config_watch_destroy(ctx->watch);
+
+	if (ctx->sigfd > 0)
+		close(ctx->sigfd);
+	loop_destroy(ctx->loop);
+
 	free(ctx);
 }
 
-static struct context *context_new(void)
+static bool context_gesture_active(struct context *ctx)
+{
+	int i;
+
+	for (i = 0; i < GESTURE_POOL_SIZE; i++)
+		if (ctx->gestures[i].gesture)
+			return true;
+
+	return false;
+}
+
+/* the recognizers only look bindings up during a gesture, swap in between */
+static void context_swap_bindings(struct context *ctx)
+{
+	bool early_commit;
+	int nfingers;
+
+	if (!ctx->next_bindings || context_gesture_active(ctx))
+		return;
+
+	bindings_destroy(ctx->bindings);
+	ctx->bindings = ctx->next_bindings;
+	ctx->next_bindings = NULL;
+
+	bindings_set(ctx->bindings);
+	early_commit = ctx->early_commit || ctx->bindings->early_commit;
+	swipe_set_early_commit(early_commit);
+
+	/* a stroke is only known not to be a shape once it ends */
+	for (nfingers = 0; early_commit && nfingers <= BINDING_FINGERS_MAX;
+	     nfingers++)
+		if (ctx->bindings->shapes[nfingers])
+			log_err("Shapes are bound for %d fingers, their swipes "
+				"fire on release despite early commit\n",
+				nfingers);
+}
+
+static void context_reload_bindings(struct context *ctx)
+{
+	struct bindings *bindings;
+
+	if (!config_watch_changed(ctx->watch))
+		return;
+
+	/* keep the current table when the new file is broken */
+	bindings = bindings_load(config_watch_get_path(ctx->watch));
+	if (!bindings)
+		return;
+
+	bindings_destroy(ctx->next_bindings);
+	ctx->next_bindings = bindings;
+	context_swap_bindings(ctx);
+}
+
+static struct context *context_new(const char *config, bool early_commit,
+				   bool touchpads_only)
 {
 	struct context *ctx = NULL;
+	const char *path;
+	struct sigaction sa = { .sa_handler = SIG_DFL };
 	sigset_t mask;
 	int ret;
 
 	ctx = calloc(1, sizeof(*ctx));
 	if (!ctx)
 		goto exit;
+	ctx->early_commit = early_commit;
+
+	ctx->loop = loop_new();
+	if (!ctx->loop)
+		goto exit;
+
+	/* a broken configuration is fatal, a missing default one is not */
+	path = config ? config : bindings_default_path();
+	if (!config && path && access(path, F_OK) == 0)
+		config = path;
+
+	ctx->next_bindings = bindings_load(config);
+	if (!ctx->next_bindings)
+		goto exit;
+	context_swap_bindings(ctx);
+
+	/* the default file may only be created later on */
+	if (path)
+		ctx->watch = config_watch_new(path);
+
+	ctx->conn = connection_new();
+	if (!ctx->conn)
+		goto exit;
+	command_init(ctx->conn);
+	workspace_init(ctx->conn);
 
 	ctx->udev = udev_new();
 	if (!ctx->udev) {
-		syslog(LOG_ERR, "Failed to create udev context\n");
+		log_err("Failed to create udev context\n");
 		goto exit;
 	}
 
-	ctx->li = libinput_udev_create_context(&interface, ctx, ctx->udev);
+	/* other devices of the seat would wake us up for nothing */
+	if (touchpads_only)
+		ctx->li = libinput_path_create_context(&interface, ctx);
+	else
+		ctx->li = libinput_udev_create_context(&interface, ctx,
+						       ctx->udev);
 	if (!ctx->li) {
-		syslog(LOG_ERR, "Failed to create libinput context\n");
+		log_err("Failed to create libinput context\n");
 		goto exit;
 	}
 
-	ret = libinput_udev_assign_seat(ctx->li, "seat0");
-	if (ret < 0) {
-		syslog(LOG_ERR, "Failed to assign udev seat: %s\n",
-			strerror(-ret));
-		goto exit;
+	if (touchpads_only) {
+		ctx->touchpads = touchpads_new(ctx->udev, ctx->li);
+		if (!ctx->touchpads)
+			goto exit;
+	} else {
+		ret = libinput_udev_assign_seat(ctx->li, "seat0");
+		if (ret < 0) {
+			log_err("Failed to assign udev seat: %s\n",
+				strerror(-ret));
+			goto exit;
+		}
 	}
 
 	/* handle signals for clean termination */
@@ -139,17 +299,27 @@ static struct context *context_new(void)
 	sigaddset(&mask, SIGINT);
 	sigaddset(&mask, SIGQUIT);
 	sigaddset(&mask, SIGTERM);
+	/* dump latency histograms */
+	sigaddset(&mask, SIGUSR1);
 	ret = sigprocmask(SIG_BLOCK, &mask, NULL);
 	if (ret < 0) {
-		syslog(LOG_ERR, "Failed to set sigprocmask: %s\n",
+		log_err("Failed to set sigprocmask: %s\n",
 			strerror(-ret));
 		goto exit;
 	}
 
-	ctx->sigfd = signalfd(-1, &mask, 0);
+	ctx->sigfd = signalfd(-1, &mask, SFD_CLOEXEC);
 	if (ctx->sigfd < 0)
 		goto exit;
 
+	/* spawned programs are reaped by the kernel, exec resets the flag */
+	sa.sa_flags = SA_NOCLDWAIT;
+	ret = sigaction(SIGCHLD, &sa, NULL);
+	if (ret < 0) {
+		log_err("Failed to set SIGCHLD action: %s\n", strerror(errno));
+		goto exit;
+	}
+
 	return ctx;
 exit:
 	context_destroy(ctx);
@@ -174,60 +344,170 @@ static bool event_is_gesture(struct libinput_event *event)
 	};
 }
 
-static int event_process_gesture(struct libinput *li,
-				 struct libinput_event *event)
+static void event_to_gesture(struct libinput_event *event,
+			     struct gesture_event *gesture_event)
 {
-	int ret = 0;
-	struct context *ctx = libinput_get_user_data(li);
-	enum libinput_event_type type;
+	struct libinput_event_gesture *li_gesture =
+		libinput_event_get_gesture_event(event);
 
-	type = libinput_event_get_type(event);
-	/* nfingers = libinput_event_gesture_get_finger_count(gesture); */
-	/* canceled = !!libinput_event_gesture_get_cancelled(gesture); */
+	memset(gesture_event, 0, sizeof(*gesture_event));
+	gesture_event->time_usec =
+		libinput_event_gesture_get_time_usec(li_gesture);
+	gesture_event->nfingers =
+		libinput_event_gesture_get_finger_count(li_gesture);
 
-	switch (type) {
+	switch (libinput_event_get_type(event)) {
 	case LIBINPUT_EVENT_GESTURE_HOLD_BEGIN:
+	case LIBINPUT_EVENT_GESTURE_HOLD_END:
+		gesture_event->type = GESTURE_HOLD;
+		break;
 	case LIBINPUT_EVENT_GESTURE_PINCH_BEGIN:
-	case LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN:
-		if (ctx->gesture) {
-			syslog(LOG_ERR, "Cancelling ongoing gesture\n");
-			gesture_destroy(ctx->gesture,
-				libinput_event_get_gesture_event(event));
-		}
-		ctx->gesture = gesture_new(
-				libinput_event_get_gesture_event(event));
-		if (!ctx->gesture) {
-			ret = -ENOMEM;
-			goto exit;
-		}
+	case LIBINPUT_EVENT_GESTURE_PINCH_UPDATE:
+	case LIBINPUT_EVENT_GESTURE_PINCH_END:
+		gesture_event->type = GESTURE_PINCH;
+		gesture_event->scale =
+			libinput_event_gesture_get_scale(li_gesture);
 		break;
+	default:
+		gesture_event->type = GESTURE_SWIPE;
+		break;
+	}
 
+	switch (libinput_event_get_type(event)) {
+	case LIBINPUT_EVENT_GESTURE_HOLD_BEGIN:
+	case LIBINPUT_EVENT_GESTURE_PINCH_BEGIN:
+	case LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN:
+		gesture_event->phase = GESTURE_BEGIN;
+		break;
 	case LIBINPUT_EVENT_GESTURE_PINCH_UPDATE:
+		gesture_event->angle =
+			libinput_event_gesture_get_angle_delta(li_gesture);
+		/* fall through */
 	case LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE:
-		if (!ctx->gesture)
-			syslog(LOG_ERR, "Missing ongoing gesture to update\n");
-		gesture_update(ctx->gesture,
-			       libinput_event_get_gesture_event(event));
-		break;
-
-	case LIBINPUT_EVENT_GESTURE_HOLD_END:
-	case LIBINPUT_EVENT_GESTURE_PINCH_END:
-	case LIBINPUT_EVENT_GESTURE_SWIPE_END:
-		if (!ctx->gesture)
-			syslog(LOG_ERR, "Missing ongoing gesture to end\n");
-		gesture_destroy(ctx->gesture,
-				libinput_event_get_gesture_event(event));
-		ctx->gesture = NULL;
+		gesture_event->phase = GESTURE_UPDATE;
+		gesture_event->dx = libinput_event_gesture_get_dx(li_gesture);
+		gesture_event->dy = libinput_event_gesture_get_dy(li_gesture);
+		gesture_event->dx_unaccel =
+			libinput_event_gesture_get_dx_unaccelerated(li_gesture);
+		gesture_event->dy_unaccel =
+			libinput_event_gesture_get_dy_unaccelerated(li_gesture);
 		break;
-
 	default:
+		gesture_event->phase = GESTURE_END;
+		gesture_event->cancelled =
+			libinput_event_gesture_get_cancelled(li_gesture);
 		break;
-	};
+	}
+}
+
+/* slot of the device, a free one is claimed for a new device */
+static struct device_gesture *context_find_gesture(struct context *ctx,
+						   struct libinput_device *device,
+						   bool claim)
+{
+	struct device_gesture *free = NULL;
+	int i;
+
+	for (i = 0; i < GESTURE_POOL_SIZE; i++) {
+		if (ctx->gestures[i].device == device)
+			return &ctx->gestures[i];
+		if (!free && !ctx->gestures[i].device)
+			free = &ctx->gestures[i];
+	}
+
+	if (!claim)
+		return NULL;
+
+	if (!free) {
+		log_err("Too many devices gesturing at once\n");
+		return NULL;
+	}
+
+	free->device = device;
+	return free;
+}
+
+static int device_gesture_dispatch(struct device_gesture *dg,
+				   struct gesture_event *gesture_event)
+{
+	struct context *ctx = dg->ctx;
+	int ret;
+
+	gesture_event->device = dg - ctx->gestures;
+	if (ctx->recorder)
+		recorder_write(ctx->recorder, gesture_event);
+
+	ret = gesture_dispatch(&dg->gesture, gesture_event);
+
+	/* event timestamps are on the loop clock */
+	if (dg->gesture) {
+		dg->type = gesture_event->type;
+		dg->nfingers = gesture_event->nfingers;
+		loop_timer_arm(ctx->loop, &dg->timer,
+			       gesture_event->time_usec + GESTURE_TIMEOUT_USEC);
+	} else {
+		/* slots are only held during a gesture */
+		loop_timer_disarm(ctx->loop, &dg->timer);
+		dg->device = NULL;
+	}
+
+	if (gesture_event->phase == GESTURE_END)
+		context_swap_bindings(ctx);
 
-exit:
 	return ret;
 }
 
+/* the END of the gesture will not come, e.g. stale or device removed */
+static void device_gesture_cancel(struct device_gesture *dg)
+{
+	struct gesture_event gesture_event = {
+		.time_usec = loop_now(),
+		.type = dg->type,
+		.phase = GESTURE_END,
+		.nfingers = dg->nfingers,
+		.cancelled = 1,
+	};
+
+	if (!dg->gesture)
+		return;
+
+	log_info("Cancelling gesture of device %td\n", dg - dg->ctx->gestures);
+
+	/* replays go through the same END */
+	device_gesture_dispatch(dg, &gesture_event);
+}
+
+static void device_gesture_expire(void *data)
+{
+	device_gesture_cancel(data);
+}
+
+static int event_process_gesture(struct libinput *li,
+				 struct libinput_event *event)
+{
+	struct context *ctx = libinput_get_user_data(li);
+	struct gesture_event gesture_event;
+	struct device_gesture *dg;
+
+	dg = context_find_gesture(ctx, libinput_event_get_device(event), true);
+	if (!dg)
+		return 0;
+
+	event_to_gesture(event, &gesture_event);
+	return device_gesture_dispatch(dg, &gesture_event);
+}
+
+static void event_process_removed(struct libinput *li,
+				  struct libinput_event *event)
+{
+	struct context *ctx = libinput_get_user_data(li);
+	struct device_gesture *dg;
+
+	dg = context_find_gesture(ctx, libinput_event_get_device(event), false);
+	if (dg)
+		device_gesture_cancel(dg);
+}
+
 static int event_process(struct libinput *li)
 {
 	int ret = 0;
@@ -238,8 +518,14 @@ static int event_process(struct libinput *li)
 		if (!event)
 			break;
 
-		if (!event_is_gesture(event))
+		if (libinput_event_get_type(event) ==
+		    LIBINPUT_EVENT_DEVICE_REMOVED)
+			event_process_removed(li, event);
+
+		if (!event_is_gesture(event)) {
+			libinput_event_destroy(event);
 			continue;
+		}
 
 		ret = event_process_gesture(li, event);
 		if (ret < 0) {
@@ -254,43 +540,203 @@ exit:
 	return ret;
 }
 
-int main(void)
+static void signal_process(struct context *ctx)
+{
+	struct signalfd_siginfo info;
+	ssize_t len;
+
+	len = read(ctx->sigfd, &info, sizeof(info));
+	if (len != sizeof(info))
+		return;
+
+	if (info.ssi_signo == SIGUSR1) {
+		latency_dump();
+		executor_dump();
+		return;
+	}
+
+	log_err("Signal received, bailing out...\n");
+	ctx->stop = 1;
+}
+
+static void sway_ready(uint32_t revents, void *data)
+{
+	struct context *ctx = data;
+
+	connection_dispatch(ctx->conn, revents);
+}
+
+static void sway_expire(void *data)
+{
+	struct context *ctx = data;
+
+	connection_timeout(ctx->conn);
+}
+
+/* replies to the commands of the throttles */
+static void executor_ready(uint32_t revents, void *data)
+{
+	executor_complete();
+}
+
+static void libinput_ready(uint32_t revents, void *data)
+{
+	struct context *ctx = data;
+
+	libinput_dispatch(ctx->li);
+	event_process(ctx->li);
+}
+
+/* parsed between input batches, swapped between gestures */
+static void config_ready(uint32_t revents, void *data)
+{
+	context_reload_bindings(data);
+}
+
+static void signal_ready(uint32_t revents, void *data)
+{
+	signal_process(data);
+}
+
+static void touchpads_ready(uint32_t revents, void *data)
+{
+	struct context *ctx = data;
+
+	/* added and removed devices come as libinput events */
+	touchpads_dispatch(ctx->touchpads);
+	libinput_dispatch(ctx->li);
+	event_process(ctx->li);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-c config] [-d] [-e] [-r file] [-t] [-x] "
+		"[-h]\n"
+		"  -c  bindings file, default $XDG_CONFIG_HOME/swayped/config\n"
+		"  -d  debug logs\n"
+		"  -e  early commit: fire swipes as soon as the direction is clear\n"
+		"  -r  record gesture events to file\n"
+		"  -t  only open touchpads, not the whole seat\n"
+		"  -x  talk to sway from a separate thread\n"
+		"  -h  show this help\n", prog);
+}
+
+int main(int argc, char *argv[])
 {
 	int ret = EXIT_SUCCESS;
 	struct context *ctx = NULL;
-	struct pollfd fds[NB_FDS];
+	const char *config = NULL;
+	bool early_commit = false;
+	bool touchpads_only = false;
+	bool executor = false;
+	const char *record = NULL;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "c:der:txh")) != -1) {
+		switch (opt) {
+		case 'c':
+			config = optarg;
+			break;
+		case 'd':
+			log_set_level(LOG_DEBUG);
+			break;
+		case 'e':
+			early_commit = true;
+			break;
+		case 'r':
+			record = optarg;
+			break;
+		case 't':
+			touchpads_only = true;
+			break;
+		case 'x':
+			executor = true;
+			break;
+		case 'h':
+			usage(argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
 
-	ctx = context_new();
+	ctx = context_new(config, early_commit, touchpads_only);
 	if (!ctx) {
 		ret = EXIT_FAILURE;
 		goto exit;
 	}
 
-	fds[LIBINPUT_FD].fd = libinput_get_fd(ctx->li);
-	fds[LIBINPUT_FD].events = POLLIN;
+	if (record) {
+		ctx->recorder = recorder_new(record);
+		if (!ctx->recorder) {
+			ret = EXIT_FAILURE;
+			goto exit;
+		}
+	}
+
+	/* after the context blocked signals, the thread inherits its mask */
+	if (executor && executor_start(ctx->conn) < 0) {
+		ret = EXIT_FAILURE;
+		goto exit;
+	}
+
+	for (i = 0; i < GESTURE_POOL_SIZE; i++) {
+		ctx->gestures[i].ctx = ctx;
+		loop_timer_init(&ctx->gestures[i].timer,
+				device_gesture_expire, &ctx->gestures[i]);
+	}
 
-	fds[SIGNAL_FD].fd = ctx->sigfd;
-	fds[SIGNAL_FD].events = POLLIN;
+	loop_timer_init(&ctx->sway_timer, sway_expire, ctx);
+
+	/* reap sway replies before new gestures queue requests */
+	ctx->sway_source = loop_add(ctx->loop, -1, 0, sway_ready, ctx);
+	/* -1 without -x */
+	ctx->executor_source = loop_add(ctx->loop, executor_get_fd(), EPOLLIN,
+					executor_ready, ctx);
+	ctx->libinput_source = loop_add(ctx->loop, libinput_get_fd(ctx->li),
+					EPOLLIN, libinput_ready, ctx);
+	/* -1 when there is nothing to watch */
+	ctx->config_source = loop_add(ctx->loop,
+				      config_watch_get_fd(ctx->watch),
+				      EPOLLIN, config_ready, ctx);
+	ctx->signal_source = loop_add(ctx->loop, ctx->sigfd, EPOLLIN,
+				      signal_ready, ctx);
+	/* -1 without -t */
+	ctx->touchpads_source = loop_add(ctx->loop,
+					 touchpads_get_fd(ctx->touchpads),
+					 EPOLLIN, touchpads_ready, ctx);
+	if (!ctx->sway_source || !ctx->executor_source ||
+	    !ctx->libinput_source ||
+	    !ctx->config_source || !ctx->signal_source ||
+	    !ctx->touchpads_source) {
+		ret = EXIT_FAILURE;
+		goto exit;
+	}
 
-	do {
-		do {
-			ret = poll(fds, NB_FDS, -1);
-		} while (ret == -1 && errno == EINTR);
+	/* subscribe to sway events early, it is fine if sway is not up yet */
+	if (!executor_running())
+		connection_connect(ctx->conn);
 
-		if (fds[LIBINPUT_FD].revents) {
-			libinput_dispatch(ctx->li);
-			event_process(ctx->li);
+	do {
+		/* the sway socket changes on reconnection, -1 when down */
+		if (!executor_running()) {
+			loop_update(ctx->loop, ctx->sway_source,
+				    connection_get_fd(ctx->conn),
+				    connection_get_events(ctx->conn));
+			connection_update_timer(ctx->conn, ctx->loop,
+						&ctx->sway_timer);
 		}
 
-		/* signals */
-		if (fds[SIGNAL_FD].revents) {
-			syslog(LOG_ERR, "Signal received, bailing out...\n");
-			ctx->stop = 1;
-		}
+		if (loop_dispatch(ctx->loop) < 0)
+			ret = EXIT_FAILURE;
 
-	} while (!ctx->stop);
+		/* once the gestures of this batch reached sway */
+		log_flush();
+	} while (!ctx->stop && ret == EXIT_SUCCESS);
 
 exit:
 	context_destroy(ctx);
+	log_flush();
 	return ret;
 }
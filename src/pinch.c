@@ -0,0 +1,97 @@
+#include <stddef.h>
+
+#include "binding.h"
+#include "command.h"
+#include "gesture.h"
+#include "latency.h"
+#include "log.h"
+#include "throttle.h"
+
+/* scale change for a completed pinch to fire its in/out binding */
+#define PINCH_SCALE_THRESHOLD	0.2
+
+struct pinch {
+	double scale;
+	int nfingers;
+	/* progress drives a continuous action */
+	bool continuous;
+	struct throttle *throttle;
+};
+
+_Static_assert(sizeof(struct pinch) <= GESTURE_DATA_SIZE,
+	       "pinch state does not fit in a gesture slot");
+
+/* per device, commands in flight outlive the gesture */
+static struct throttle pinch_throttles[GESTURE_POOL_SIZE];
+
+static int pinch_begin(struct gesture *gest, const struct gesture_event *event)
+{
+	int ret = 0;
+	struct pinch *pi = gesture_get_data(gest);
+	const struct action *action;
+
+	pi->scale = 1.0;
+	pi->nfingers = event->nfingers;
+	pi->throttle = &pinch_throttles[event->device % GESTURE_POOL_SIZE];
+
+	action = binding_lookup(GESTURE_PINCH, pi->nfingers,
+				BINDING_CONTINUOUS);
+	if (action) {
+		pi->continuous = true;
+		throttle_start(pi->throttle, &action->continuous);
+	}
+
+	return ret;
+}
+
+static int pinch_update(struct gesture *gest, const struct gesture_event *event)
+{
+	struct pinch *pi = gesture_get_data(gest);
+	double scale = event->scale;
+
+	if (pi->continuous)
+		throttle_update(pi->throttle, scale - pi->scale,
+				event->time_usec);
+	pi->scale = scale;
+
+	return 0;
+}
+
+static int pinch_end(struct gesture *gest, const struct gesture_event *event)
+{
+	struct pinch *pi = gesture_get_data(gest);
+	const struct action *action = NULL;
+	bool cancelled = gesture_cancelled(event);
+
+	log_debug("%s: scale %f fingers %d\n", __func__,
+		  pi->scale, pi->nfingers);
+
+	if (pi->continuous)
+		throttle_end(pi->throttle, cancelled);
+
+	if (cancelled)
+		return 0;
+
+	if (pi->scale < 1.0 - PINCH_SCALE_THRESHOLD)
+		action = binding_lookup(GESTURE_PINCH, pi->nfingers, BINDING_IN);
+	else if (pi->scale > 1.0 + PINCH_SCALE_THRESHOLD)
+		action = binding_lookup(GESTURE_PINCH, pi->nfingers, BINDING_OUT);
+
+	if (action) {
+		latency_recognized();
+		command_execute(action);
+	}
+
+	return 0;
+}
+
+static struct gesture_ops pinch_ops = {
+	.begin  = pinch_begin,
+	.update = pinch_update,
+	.end    = pinch_end,
+};
+
+struct gesture_ops *pinch_get_ops(void)
+{
+	return &pinch_ops;
+}
@@ -0,0 +1,121 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "log.h"
+#include "record.h"
+
+struct recorder {
+	/* buffered, events are only written out when the buffer is full */
+	FILE *file;
+};
+
+struct recorder *recorder_new(const char *path)
+{
+	struct record_header header = {
+		.magic = RECORD_MAGIC,
+		.version = RECORD_VERSION,
+		.event_size = sizeof(struct gesture_event),
+	};
+	struct recorder *rec;
+
+	rec = calloc(1, sizeof(*rec));
+	if (!rec)
+		return NULL;
+
+	rec->file = fopen(path, "we");
+	if (!rec->file) {
+		log_err("Failed to open %s: %s\n", path, strerror(errno));
+		goto error;
+	}
+
+	if (fwrite(&header, sizeof(header), 1, rec->file) != 1) {
+		log_err("Failed to write %s\n", path);
+		goto error;
+	}
+
+	log_info("Recording gestures to %s\n", path);
+	return rec;
+
+error:
+	recorder_destroy(rec);
+	return NULL;
+}
+
+void recorder_destroy(struct recorder *rec)
+{
+	if (!rec)
+		return;
+
+	if (rec->file)
+		fclose(rec->file);
+	free(rec);
+}
+
+void recorder_write(struct recorder *rec, const struct gesture_event *event)
+{
+	if (fwrite(event, sizeof(*event), 1, rec->file) != 1)
+		log_err("Failed to record gesture event\n");
+}
+
+int recording_open(struct recording *recording, const char *path)
+{
+	const struct record_header *header;
+	struct stat st;
+	int fd, ret = 0;
+
+	memset(recording, 0, sizeof(*recording));
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	if (fstat(fd, &st) < 0) {
+		ret = -errno;
+		goto exit;
+	}
+
+	if ((size_t)st.st_size < sizeof(*header)) {
+		ret = -EINVAL;
+		goto exit;
+	}
+
+	recording->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (recording->map == MAP_FAILED) {
+		recording->map = NULL;
+		ret = -errno;
+		goto exit;
+	}
+	recording->size = st.st_size;
+
+	header = recording->map;
+	if (memcmp(header->magic, RECORD_MAGIC, sizeof(RECORD_MAGIC)) ||
+	    header->version != RECORD_VERSION ||
+	    header->event_size != sizeof(struct gesture_event)) {
+		recording_close(recording);
+		ret = -EINVAL;
+		goto exit;
+	}
+
+	/* a trailing partial record is from an interrupted recording */
+	recording->events = (const struct gesture_event *)(header + 1);
+	recording->count = (recording->size - sizeof(*header)) /
+			   sizeof(struct gesture_event);
+
+exit:
+	close(fd);
+	return ret;
+}
+
+void recording_close(struct recording *recording)
+{
+	if (recording->map)
+		munmap(recording->map, recording->size);
+	memset(recording, 0, sizeof(*recording));
+}
@@ -0,0 +1,39 @@
+#ifndef _RECORD_H_
+#define _RECORD_H_
+
+#include <stddef.h>
+
+#include "gesture.h"
+
+/*
+ * Recordings are a header followed by struct gesture_event records as laid
+ * out in memory, so they are only portable between hosts of the same
+ * endianness.
+ */
+#define RECORD_MAGIC	"SWPDREC"
+#define RECORD_VERSION	1
+
+struct record_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t event_size;
+};
+
+struct recorder;
+
+struct recorder *recorder_new(const char *path);
+void recorder_destroy(struct recorder *rec);
+void recorder_write(struct recorder *rec, const struct gesture_event *event);
+
+/* read-only mapping of a recording */
+struct recording {
+	void *map;
+	size_t size;
+	const struct gesture_event *events;
+	size_t count;
+};
+
+int recording_open(struct recording *recording, const char *path);
+void recording_close(struct recording *recording);
+
+#endif
@@ -0,0 +1,65 @@
+#include <math.h>
+
+#include "binding.h"
+#include "sector.h"
+
+static uint32_t sector_tan(double degrees)
+{
+	return lround(tan(degrees * M_PI / 180) * (1 << SECTOR_TAN_SHIFT));
+}
+
+void sectors_init(struct sectors *sectors, double diagonal_width)
+{
+	double cardinal_width = 90 - diagonal_width;
+
+	sectors->boundary = sector_tan(cardinal_width / 2);
+	sectors->cardinal = sector_tan(cardinal_width / 4);
+	/* 0 when there are no diagonals, not even on the exact 45 degrees */
+	sectors->diagonal = diagonal_width > 0 ?
+			    sector_tan(45 - diagonal_width / 4) : 0;
+}
+
+static uint64_t sector_coord(double value)
+{
+	value = fabs(value);
+	if (value > SECTOR_COORD_MAX)
+		value = SECTOR_COORD_MAX;
+
+	return value * (1 << SECTOR_COORD_SHIFT);
+}
+
+/* y <= tan * x, all in the first quadrant */
+static bool sector_below(uint64_t x, uint64_t y, uint32_t tan)
+{
+	return y << SECTOR_TAN_SHIFT <= x * tan;
+}
+
+int sectors_classify(const struct sectors *sectors, double dx, double dy,
+		     bool strict)
+{
+	uint64_t x = sector_coord(dx), y = sector_coord(dy);
+
+	if (!x && !y)
+		return -1;
+
+	if (sector_below(x, y, sectors->boundary)) {
+		if (strict && !sector_below(x, y, sectors->cardinal))
+			return -1;
+		return dx > 0 ? BINDING_RIGHT : BINDING_LEFT;
+	}
+
+	if (sector_below(y, x, sectors->boundary)) {
+		if (strict && !sector_below(y, x, sectors->cardinal))
+			return -1;
+		return dy > 0 ? BINDING_DOWN : BINDING_UP;
+	}
+
+	if (strict && (!sectors->diagonal ||
+		       y << SECTOR_TAN_SHIFT < x * sectors->diagonal ||
+		       x << SECTOR_TAN_SHIFT < y * sectors->diagonal))
+		return -1;
+
+	if (dy > 0)
+		return dx > 0 ? BINDING_DOWN_RIGHT : BINDING_DOWN_LEFT;
+	return dx > 0 ? BINDING_UP_RIGHT : BINDING_UP_LEFT;
+}
@@ -0,0 +1,37 @@
+#ifndef _SECTOR_H_
+#define _SECTOR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* boundaries are tangents in fixed point, coordinates too */
+#define SECTOR_TAN_SHIFT	16
+#define SECTOR_COORD_SHIFT	8
+/* larger deltas are clamped, only their ratio matters */
+#define SECTOR_COORD_MAX	1e6
+
+/*
+ * Eight direction sectors: diagonals are diagonal_width degrees wide and
+ * the axes get the rest of each quadrant. Boundaries are computed once so
+ * that classifying is a few integer multiplications.
+ */
+struct sectors {
+	/* tan(cardinal width / 2), between axis and diagonal sectors */
+	uint32_t boundary;
+	/* tan(cardinal width / 4), middle half of the axis sectors */
+	uint32_t cardinal;
+	/* tan(45 - diagonal width / 4), middle half of diagonal sectors */
+	uint32_t diagonal;
+};
+
+/* diagonal_width in degrees, from 0 (no diagonals) to 90 */
+void sectors_init(struct sectors *sectors, double diagonal_width);
+
+/*
+ * enum binding_direction of a dx, dy motion, -1 for no motion. With strict,
+ * motions outside of the middle half of their sector give -1 as well.
+ */
+int sectors_classify(const struct sectors *sectors, double dx, double dy,
+		     bool strict);
+
+#endif
@@ -0,0 +1,367 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "binding.h"
+#include "command.h"
+#include "gesture.h"
+#include "latency.h"
+#include "log.h"
+#include "swipe.h"
+
+/*
+ * $1 recognizer style matching of swipe strokes. The stroke is resampled
+ * on the fly into points equally spaced along the path: when the buffer
+ * fills up every other point is dropped and the spacing doubles, so that
+ * memory and the work left for END are bounded whatever the stroke length.
+ * On END the points are resampled to SHAPE_POINTS, normalized and compared
+ * with every template. There is no rotation invariance, direction matters.
+ */
+
+/* compared with the templates */
+#define SHAPE_POINTS		32
+#define SHAPE_STROKE_MAX	(2 * SHAPE_POINTS)
+/* spacing of the first points, in unaccelerated units */
+#define SHAPE_STEP		2.0f
+/* smaller strokes are plain swipes */
+#define SHAPE_MIN_SIZE		100.0f
+/* normalized coordinates are Q10, within [-1024, 1024] of the centroid */
+#define SHAPE_ONE		1024
+/* mean squared distance to the best template, in Q10 squared */
+#define SHAPE_MATCH_MAX		(SHAPE_ONE * SHAPE_ONE / 80)
+
+struct shape {
+	/* strokes matching no shape are plain swipes */
+	struct swipe swipe;
+	/* position, and path length since the last point */
+	float x;
+	float y;
+	float dist;
+	float step;
+	int count;
+	float px[SHAPE_STROKE_MAX];
+	float py[SHAPE_STROKE_MAX];
+};
+
+_Static_assert(sizeof(struct shape) <= GESTURE_DATA_SIZE,
+	       "shape state does not fit in a gesture slot");
+
+/* template polylines, y grows downwards as libinput deltas do */
+struct shape_vertex {
+	float x;
+	float y;
+};
+
+#define SHAPE_CIRCLE_VERTICES	17
+#define SHAPE_VERTICES_MAX	SHAPE_CIRCLE_VERTICES
+
+static const struct {
+	/* -1 for straight lines, matched to tell them from shapes */
+	int direction;
+	int count;
+	struct shape_vertex vertices[SHAPE_VERTICES_MAX];
+} shape_polylines[] = {
+	{ BINDING_SHAPE_L,     3, { { 0, 0 }, { 0, 1 }, { 0.6, 1 } } },
+	{ BINDING_SHAPE_Z,     4, { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } } },
+	{ BINDING_SHAPE_V,     3, { { 0, 0 }, { 0.5, 1 }, { 1, 0 } } },
+	{ BINDING_SHAPE_CARET, 3, { { 0, 1 }, { 0.5, 0 }, { 1, 1 } } },
+	{ -1, 2, { { 0, 0 }, { 1, 0 } } },
+	{ -1, 2, { { 1, 0 }, { 0, 0 } } },
+	{ -1, 2, { { 0, 0 }, { 0, 1 } } },
+	{ -1, 2, { { 0, 1 }, { 0, 0 } } },
+	{ -1, 2, { { 0, 0 }, { 1, 1 } } },
+	{ -1, 2, { { 1, 1 }, { 0, 0 } } },
+	{ -1, 2, { { 1, 0 }, { 0, 1 } } },
+	{ -1, 2, { { 0, 1 }, { 1, 0 } } },
+};
+
+#define SHAPE_POLYLINES	(sizeof(shape_polylines) / sizeof(shape_polylines[0]))
+/* both circles are generated, starting from the top */
+#define SHAPE_TEMPLATES	(SHAPE_POLYLINES + 2)
+
+/* structure of arrays so that distance loops vectorize */
+static struct {
+	int direction[SHAPE_TEMPLATES];
+	int16_t x[SHAPE_TEMPLATES][SHAPE_POINTS];
+	int16_t y[SHAPE_TEMPLATES][SHAPE_POINTS];
+} templates;
+
+static bool templates_ready;
+
+/* plain swipes are logged by swipe_detected() */
+static const char * const direction_str[] = {
+	[BINDING_CIRCLE_CW]   = "CIRCLE_CW",
+	[BINDING_CIRCLE_CCW]  = "CIRCLE_CCW",
+	[BINDING_SHAPE_L]     = "L",
+	[BINDING_SHAPE_Z]     = "Z",
+	[BINDING_SHAPE_V]     = "V",
+	[BINDING_SHAPE_CARET] = "CARET",
+};
+
+/* n >= 2 points of a non-empty path to SHAPE_POINTS equally spaced ones */
+static void shape_resample(const float *x, const float *y, int n,
+			   float *rx, float *ry)
+{
+	float length = 0, interval, acc = 0, d, t, px, py;
+	int i, m = 1;
+
+	for (i = 1; i < n; i++)
+		length += hypotf(x[i] - x[i - 1], y[i] - y[i - 1]);
+	interval = length / (SHAPE_POINTS - 1);
+
+	px = rx[0] = x[0];
+	py = ry[0] = y[0];
+	for (i = 1; i < n && m < SHAPE_POINTS; i++) {
+		d = hypotf(x[i] - px, y[i] - py);
+		while (d > 0 && acc + d >= interval && m < SHAPE_POINTS) {
+			t = (interval - acc) / d;
+			px += t * (x[i] - px);
+			py += t * (y[i] - py);
+			rx[m] = px;
+			ry[m] = py;
+			m++;
+			d = hypotf(x[i] - px, y[i] - py);
+			acc = 0;
+		}
+		acc += d;
+		px = x[i];
+		py = y[i];
+	}
+
+	/* rounding may leave the last ones out */
+	for (; m < SHAPE_POINTS; m++) {
+		rx[m] = x[n - 1];
+		ry[m] = y[n - 1];
+	}
+}
+
+/*
+ * Centered on the centroid and scaled down uniformly to a unit box, aspect
+ * is kept so that lines stay lines. Returns the size before scaling.
+ */
+static float shape_normalize(const float *x, const float *y,
+			     int16_t *nx, int16_t *ny)
+{
+	float cx = 0, cy = 0, min_x = x[0], max_x = x[0];
+	float min_y = y[0], max_y = y[0], size, scale;
+	int i;
+
+	for (i = 0; i < SHAPE_POINTS; i++) {
+		cx += x[i];
+		cy += y[i];
+		min_x = fminf(min_x, x[i]);
+		max_x = fmaxf(max_x, x[i]);
+		min_y = fminf(min_y, y[i]);
+		max_y = fmaxf(max_y, y[i]);
+	}
+	cx /= SHAPE_POINTS;
+	cy /= SHAPE_POINTS;
+
+	size = fmaxf(max_x - min_x, max_y - min_y);
+	if (size <= 0)
+		return 0;
+
+	scale = SHAPE_ONE / size;
+	for (i = 0; i < SHAPE_POINTS; i++) {
+		nx[i] = lrintf((x[i] - cx) * scale);
+		ny[i] = lrintf((y[i] - cy) * scale);
+	}
+
+	return size;
+}
+
+static void shape_templates_init(void)
+{
+	float x[SHAPE_VERTICES_MAX], y[SHAPE_VERTICES_MAX];
+	float rx[SHAPE_POINTS], ry[SHAPE_POINTS];
+	unsigned int i, t = 0;
+	int v;
+
+	for (i = 0; i < SHAPE_POLYLINES; i++, t++) {
+		for (v = 0; v < shape_polylines[i].count; v++) {
+			x[v] = shape_polylines[i].vertices[v].x;
+			y[v] = shape_polylines[i].vertices[v].y;
+		}
+		shape_resample(x, y, shape_polylines[i].count, rx, ry);
+		shape_normalize(rx, ry, templates.x[t], templates.y[t]);
+		templates.direction[t] = shape_polylines[i].direction;
+	}
+
+	/* clockwise on screen, from the top */
+	for (v = 0; v < SHAPE_CIRCLE_VERTICES; v++) {
+		x[v] = sinf(2 * M_PI * v / (SHAPE_CIRCLE_VERTICES - 1));
+		y[v] = -cosf(2 * M_PI * v / (SHAPE_CIRCLE_VERTICES - 1));
+	}
+	shape_resample(x, y, SHAPE_CIRCLE_VERTICES, rx, ry);
+	shape_normalize(rx, ry, templates.x[t], templates.y[t]);
+	templates.direction[t++] = BINDING_CIRCLE_CW;
+
+	for (v = 0; v < SHAPE_CIRCLE_VERTICES; v++)
+		x[v] = -x[v];
+	shape_resample(x, y, SHAPE_CIRCLE_VERTICES, rx, ry);
+	shape_normalize(rx, ry, templates.x[t], templates.y[t]);
+	templates.direction[t++] = BINDING_CIRCLE_CCW;
+
+	templates_ready = true;
+}
+
+/* mean squared distance, integer arithmetic without branches */
+static int32_t shape_distance(const int16_t *ax, const int16_t *ay,
+			      const int16_t *bx, const int16_t *by)
+{
+	int32_t sum = 0, ex, ey;
+	int i;
+
+	for (i = 0; i < SHAPE_POINTS; i++) {
+		ex = ax[i] - bx[i];
+		ey = ay[i] - by[i];
+		sum += ex * ex + ey * ey;
+	}
+
+	return sum / SHAPE_POINTS;
+}
+
+static void shape_point(struct shape *sh, float x, float y)
+{
+	int i;
+
+	/* the new point falls on the doubled spacing too */
+	if (sh->count == SHAPE_STROKE_MAX) {
+		for (i = 0; i < SHAPE_POINTS; i++) {
+			sh->px[i] = sh->px[2 * i];
+			sh->py[i] = sh->py[2 * i];
+		}
+		sh->count = SHAPE_POINTS;
+		sh->step *= 2;
+	}
+
+	sh->px[sh->count] = x;
+	sh->py[sh->count] = y;
+	sh->count++;
+}
+
+/* best template, -1 for none or a straight line */
+static int shape_match(struct shape *sh)
+{
+	float rx[SHAPE_POINTS], ry[SHAPE_POINTS];
+	int16_t nx[SHAPE_POINTS], ny[SHAPE_POINTS];
+	int32_t distance, best = INT32_MAX;
+	unsigned int t;
+	int direction = -1;
+
+	/* the path since the last point */
+	if (sh->dist > 0 && sh->count < SHAPE_STROKE_MAX) {
+		sh->px[sh->count] = sh->x;
+		sh->py[sh->count] = sh->y;
+		sh->count++;
+	}
+
+	if (sh->count < 2)
+		return -1;
+
+	shape_resample(sh->px, sh->py, sh->count, rx, ry);
+	if (shape_normalize(rx, ry, nx, ny) < SHAPE_MIN_SIZE)
+		return -1;
+
+	for (t = 0; t < SHAPE_TEMPLATES; t++) {
+		distance = shape_distance(nx, ny, templates.x[t],
+					  templates.y[t]);
+		if (distance < best) {
+			best = distance;
+			direction = templates.direction[t];
+		}
+	}
+
+	log_debug("%s: best %d distance %d\n", __func__, direction, best);
+
+	return best <= SHAPE_MATCH_MAX ? direction : -1;
+}
+
+static void shape_detected(struct shape *sh, int direction)
+{
+	const struct action *action;
+
+	latency_recognized();
+	log_info("%s: %s fingers %d\n", __func__, direction_str[direction],
+		 sh->swipe.nfingers);
+
+	action = binding_lookup(GESTURE_SWIPE, sh->swipe.nfingers, direction);
+	if (action)
+		command_execute(action);
+}
+
+static int shape_begin(struct gesture *gest, const struct gesture_event *event)
+{
+	struct shape *sh = gesture_get_data(gest);
+
+	if (!templates_ready)
+		shape_templates_init();
+
+	sh->swipe.nfingers = event->nfingers;
+	sh->step = SHAPE_STEP;
+	shape_point(sh, 0, 0);
+
+	return 0;
+}
+
+static int shape_update(struct gesture *gest, const struct gesture_event *event)
+{
+	struct shape *sh = gesture_get_data(gest);
+	float x = sh->x + event->dx_unaccel;
+	float y = sh->y + event->dy_unaccel;
+	float d = hypotf(x - sh->x, y - sh->y);
+	float t;
+
+	swipe_track(&sh->swipe, event);
+
+	/* points every step along the path */
+	while (d > 0 && sh->dist + d >= sh->step) {
+		t = (sh->step - sh->dist) / d;
+		sh->x += t * (x - sh->x);
+		sh->y += t * (y - sh->y);
+		shape_point(sh, sh->x, sh->y);
+		d = hypotf(x - sh->x, y - sh->y);
+		sh->dist = 0;
+	}
+
+	sh->dist += d;
+	sh->x = x;
+	sh->y = y;
+
+	return 0;
+}
+
+static int shape_end(struct gesture *gest, const struct gesture_event *event)
+{
+	struct shape *sh = gesture_get_data(gest);
+	enum binding_direction swipe_direction;
+	int direction;
+
+	if (gesture_cancelled(event)) {
+		log_debug("%s: shape cancelled\n", __func__);
+		return 0;
+	}
+
+	direction = shape_match(sh);
+	if (direction >= 0) {
+		shape_detected(sh, direction);
+		return 0;
+	}
+
+	/* not a shape, flings included as on the plain swipe path */
+	if (swipe_recognize(&sh->swipe, event->time_usec, &swipe_direction))
+		swipe_detected(&sh->swipe, swipe_direction);
+
+	return 0;
+}
+
+static struct gesture_ops shape_ops = {
+	.begin  = shape_begin,
+	.update = shape_update,
+	.end    = shape_end,
+};
+
+struct gesture_ops *shape_get_ops(void)
+{
+	return &shape_ops;
+}
@@ -1,9 +1,11 @@
 #define _POSIX_C_SOURCE 200809L
+#include <errno.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <unistd.h>
 #include "ipc-client.h"
@@ -11,7 +13,22 @@
 
 static const char ipc_magic[] = {'i', '3', '-', 'i', 'p', 'c'};
 
-#define IPC_HEADER_SIZE (sizeof(ipc_magic) + 8)
+_Static_assert(IPC_HEADER_SIZE == sizeof(ipc_magic) + 8, "IPC header size");
+
+void ipc_header_encode(char *buf, uint32_t type, uint32_t len) {
+	memcpy(buf, ipc_magic, sizeof(ipc_magic));
+	memcpy(buf + sizeof(ipc_magic), &len, sizeof(len));
+	memcpy(buf + sizeof(ipc_magic) + sizeof(len), &type, sizeof(type));
+}
+
+bool ipc_header_decode(const char *buf, uint32_t *type, uint32_t *len) {
+	if (memcmp(buf, ipc_magic, sizeof(ipc_magic)) != 0) {
+		return false;
+	}
+	memcpy(len, buf + sizeof(ipc_magic), sizeof(*len));
+	memcpy(type, buf + sizeof(ipc_magic) + sizeof(*len), sizeof(*type));
+	return true;
+}
 
 char *get_socketpath(void) {
 	const char *swaysock = getenv("SWAYSOCK");
@@ -56,15 +73,18 @@ char *get_socketpath(void) {
 int ipc_open_socket(const char *socket_path) {
 	struct sockaddr_un addr;
 	int socketfd;
-	if ((socketfd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
-		sway_abort("Unable to open Unix socket");
+	if ((socketfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1) {
+		sway_log_errno(SWAY_ERROR, "Unable to open Unix socket");
+		return -1;
 	}
 	addr.sun_family = AF_UNIX;
 	strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
 	addr.sun_path[sizeof(addr.sun_path) - 1] = 0;
 	int l = sizeof(struct sockaddr_un);
 	if (connect(socketfd, (struct sockaddr *)&addr, l) == -1) {
-		sway_abort("Unable to connect to %s", socket_path);
+		sway_log_errno(SWAY_ERROR, "Unable to connect to %s", socket_path);
+		close(socketfd);
+		return -1;
 	}
 	return socketfd;
 }
@@ -77,73 +97,168 @@ bool ipc_set_recv_timeout(int socketfd, struct timeval tv) {
 	return true;
 }
 
-struct ipc_response *ipc_recv_response(int socketfd) {
-	char data[IPC_HEADER_SIZE];
+// most replies fit, GET_TREE ones grow the buffer once
+#define IPC_BUFFER_MIN_SIZE 4096
+
+// size includes the NUL terminator, the received bytes are kept
+static bool ipc_buffer_reserve(struct ipc_buffer *buf, size_t size) {
+	if (size <= buf->size) {
+		return true;
+	}
+	size_t new_size = buf->size ? buf->size : IPC_BUFFER_MIN_SIZE;
+	while (new_size < size) {
+		new_size *= 2;
+	}
+	char *data = realloc(buf->data, new_size);
+	if (!data) {
+		return false;
+	}
+	buf->data = data;
+	buf->size = new_size;
+	return true;
+}
 
+void ipc_buffer_finish(struct ipc_buffer *buf) {
+	free(buf->data);
+	buf->data = NULL;
+	buf->size = 0;
+}
+
+char *ipc_recv_response_into(int socketfd, struct ipc_buffer *buf,
+		uint32_t *type, uint32_t *len) {
+	char header[IPC_HEADER_SIZE];
+
+	if (!ipc_buffer_reserve(buf, IPC_BUFFER_MIN_SIZE)) {
+		goto error_alloc;
+	}
+
+	// small replies come in a single read, header and payload
+	struct iovec iov[2] = {
+		{ .iov_base = header, .iov_len = IPC_HEADER_SIZE },
+		{ .iov_base = buf->data, .iov_len = buf->size - 1 },
+	};
 	size_t total = 0;
 	while (total < IPC_HEADER_SIZE) {
-		ssize_t received = recv(socketfd, data + total, IPC_HEADER_SIZE - total, 0);
+		ssize_t received = readv(socketfd, iov, 2);
 		if (received <= 0) {
-			sway_abort("Unable to receive IPC response");
+			sway_log_errno(SWAY_ERROR, "Unable to receive IPC response");
+			return NULL;
 		}
 		total += received;
+		if (total < IPC_HEADER_SIZE) {
+			iov[0].iov_base = header + total;
+			iov[0].iov_len = IPC_HEADER_SIZE - total;
+		}
 	}
 
-	struct ipc_response *response = malloc(sizeof(struct ipc_response));
-	if (!response) {
-		goto error_1;
+	// more would be the start of a message we did not ask for
+	total -= IPC_HEADER_SIZE;
+	if (!ipc_header_decode(header, type, len) || total > *len) {
+		sway_log(SWAY_ERROR, "Malformed IPC response");
+		errno = EPROTO;
+		return NULL;
 	}
 
-	memcpy(&response->size, data + sizeof(ipc_magic), sizeof(uint32_t));
-	memcpy(&response->type, data + sizeof(ipc_magic) + sizeof(uint32_t), sizeof(uint32_t));
-
-	char *payload = malloc(response->size + 1);
-	if (!payload) {
-		goto error_2;
+	if (!ipc_buffer_reserve(buf, (size_t)*len + 1)) {
+		goto error_alloc;
 	}
 
-	total = 0;
-	while (total < response->size) {
-		ssize_t received = recv(socketfd, payload + total, response->size - total, 0);
-		if (received < 0) {
-			sway_abort("Unable to receive IPC response");
+	while (total < *len) {
+		ssize_t received = recv(socketfd, buf->data + total, *len - total, 0);
+		if (received <= 0) {
+			sway_log_errno(SWAY_ERROR, "Unable to receive IPC response");
+			return NULL;
 		}
 		total += received;
 	}
-	payload[response->size] = '\0';
-	response->payload = payload;
+	buf->data[*len] = '\0';
 
-	return response;
-error_2:
-	free(response);
-error_1:
+	return buf->data;
+error_alloc:
 	sway_log(SWAY_ERROR, "Unable to allocate memory for IPC response");
+	errno = ENOMEM;
 	return NULL;
 }
 
+struct ipc_response *ipc_recv_response(int socketfd) {
+	struct ipc_response *response = malloc(sizeof(struct ipc_response));
+	if (!response) {
+		sway_log(SWAY_ERROR, "Unable to allocate memory for IPC response");
+		return NULL;
+	}
+
+	// the buffer is handed over to the response
+	struct ipc_buffer buf = { 0 };
+	response->payload = ipc_recv_response_into(socketfd, &buf,
+			&response->type, &response->size);
+	if (!response->payload) {
+		ipc_buffer_finish(&buf);
+		free(response);
+		return NULL;
+	}
+
+	return response;
+}
+
 void free_ipc_response(struct ipc_response *response) {
 	free(response->payload);
 	free(response);
 }
 
-char *ipc_single_command(int socketfd, uint32_t type, const char *payload, uint32_t *len) {
+static bool ipc_send_all(int socketfd, struct iovec *iov, int iovcnt) {
+	struct msghdr msg = { .msg_iov = iov, .msg_iovlen = iovcnt };
+	while (msg.msg_iovlen > 0) {
+		// MSG_NOSIGNAL: a dead sway must not kill us with SIGPIPE
+		ssize_t sent = sendmsg(socketfd, &msg, MSG_NOSIGNAL);
+		if (sent == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		// skip what was sent, the header may only be partially
+		while (msg.msg_iovlen > 0 && (size_t)sent >= msg.msg_iov->iov_len) {
+			sent -= msg.msg_iov->iov_len;
+			msg.msg_iov++;
+			msg.msg_iovlen--;
+		}
+		if (msg.msg_iovlen > 0) {
+			msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + sent;
+			msg.msg_iov->iov_len -= sent;
+		}
+	}
+	return true;
+}
+
+char *ipc_single_command_into(int socketfd, struct ipc_buffer *buf,
+		uint32_t type, const char *payload, uint32_t *len) {
 	char data[IPC_HEADER_SIZE];
-	memcpy(data, ipc_magic, sizeof(ipc_magic));
-	memcpy(data + sizeof(ipc_magic), len, sizeof(*len));
-	memcpy(data + sizeof(ipc_magic) + sizeof(*len), &type, sizeof(type));
+	ipc_header_encode(data, type, *len);
 
-	if (write(socketfd, data, IPC_HEADER_SIZE) == -1) {
-		sway_abort("Unable to send IPC header");
+	struct iovec iov[2] = {
+		{ .iov_base = data, .iov_len = IPC_HEADER_SIZE },
+		{ .iov_base = (char *)payload, .iov_len = *len },
+	};
+	if (!ipc_send_all(socketfd, iov, 2)) {
+		int err = errno;
+		sway_log_errno(SWAY_ERROR, "Unable to send IPC command");
+		errno = err;
+		return NULL;
 	}
 
-	if (write(socketfd, payload, *len) == -1) {
-		sway_abort("Unable to send IPC payload");
-	}
+	uint32_t resp_type;
+	return ipc_recv_response_into(socketfd, buf, &resp_type, len);
+}
 
-	struct ipc_response *resp = ipc_recv_response(socketfd);
-	char *response = resp->payload;
-	*len = resp->size;
-	free(resp);
+char *ipc_single_command(int socketfd, uint32_t type, const char *payload, uint32_t *len) {
+	// the payload starts the buffer, freeing it frees the buffer
+	struct ipc_buffer buf = { 0 };
+	char *response = ipc_single_command_into(socketfd, &buf, type, payload, len);
+	if (!response) {
+		int err = errno;
+		ipc_buffer_finish(&buf);
+		errno = err;
+	}
 
 	return response;
 }
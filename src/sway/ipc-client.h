@@ -5,11 +5,26 @@
 #define JSON_MAX_DEPTH 512
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <sys/time.h>
 
 #include "ipc.h"
 
+/**
+ * Size of the IPC header: magic string, payload length and payload type.
+ */
+#define IPC_HEADER_SIZE 14
+
+/**
+ * Receive buffer owned by the caller and reused across responses. It grows
+ * to the largest payload seen and is only released by ipc_buffer_finish().
+ */
+struct ipc_buffer {
+	char *data;
+	size_t size;
+};
+
 /**
  * IPC response including type of IPC response, size of payload and the json
  * encoded payload string.
@@ -20,21 +35,49 @@ struct ipc_response {
 	char *payload;
 };
 
+/**
+ * Writes the IPC header of a message of the given type and payload length.
+ */
+void ipc_header_encode(char *buf, uint32_t type, uint32_t len);
+/**
+ * Reads type and payload length from an IPC header. Returns false if the
+ * magic string does not match.
+ */
+bool ipc_header_decode(const char *buf, uint32_t *type, uint32_t *len);
 /**
  * Gets the path to the IPC socket from sway.
  */
 char *get_socketpath(void);
 /**
- * Opens the sway socket.
+ * Opens the sway socket. Returns -1 if the socket cannot be connected.
  */
 int ipc_open_socket(const char *socket_path);
+/**
+ * Frees the memory of a receive buffer, which may then be reused.
+ */
+void ipc_buffer_finish(struct ipc_buffer *buf);
+/**
+ * Receives a single IPC response into buf, the header and the start of the
+ * payload with a single readv(). Returns the NUL terminated payload, which
+ * lives in buf until the next response, or NULL if the socket failed or was
+ * closed. The socket must only carry replies to the caller's requests.
+ */
+char *ipc_recv_response_into(int socketfd, struct ipc_buffer *buf,
+		uint32_t *type, uint32_t *len);
+/**
+ * Same as ipc_single_command(), the response payload is stored in buf.
+ */
+char *ipc_single_command_into(int socketfd, struct ipc_buffer *buf,
+		uint32_t type, const char *payload, uint32_t *len);
 /**
  * Issues a single IPC command and returns the buffer. len will be updated with
- * the length of the buffer returned from sway.
+ * the length of the buffer returned from sway. Returns NULL on failure, with
+ * errno set by the failing socket operation.
  */
 char *ipc_single_command(int socketfd, uint32_t type, const char *payload, uint32_t *len);
 /**
- * Receives a single IPC response and returns an ipc_response.
+ * Receives a single IPC response and returns an ipc_response, or NULL if the
+ * socket failed or was closed.
  */
 struct ipc_response *ipc_recv_response(int socketfd);
 /**
@@ -1,113 +1,202 @@
 #include <errno.h>
 #include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <sys/syslog.h>
 
+#include "binding.h"
 #include "command.h"
 #include "gesture.h"
+#include "latency.h"
+#include "log.h"
+#include "swipe.h"
+
+_Static_assert(sizeof(struct swipe) <= GESTURE_DATA_SIZE,
+	       "swipe state does not fit in a gesture slot");
+
+/* fire as soon as the direction is clear instead of on END */
+static bool early_commit;
+
+static const char * const swipe_direction_str[] = {
+	[BINDING_UP]         = "UP",
+	[BINDING_DOWN]       = "DOWN",
+	[BINDING_LEFT]       = "LEFT",
+	[BINDING_RIGHT]      = "RIGHT",
+	[BINDING_UP_LEFT]    = "UP_LEFT",
+	[BINDING_UP_RIGHT]   = "UP_RIGHT",
+	[BINDING_DOWN_LEFT]  = "DOWN_LEFT",
+	[BINDING_DOWN_RIGHT] = "DOWN_RIGHT",
+};
 
-#define SWIPE_DIST_THRESHOLD	100.0
-#define OBLIQUE_RATIO		(tan(M_PI / 8))
+void swipe_detected(struct swipe *sw, enum binding_direction direction)
+{
+	const struct action *action;
 
-enum swipe_direction {
-	SWIPE_UP,
-	SWIPE_DOWN,
-	SWIPE_LEFT,
-	SWIPE_RIGHT
-};
+	latency_recognized();
+	log_info("%s: %s fingers %d\n", __func__,
+		 swipe_direction_str[direction], sw->nfingers);
 
-struct swipe {
-	double dx;
-	double dy;
-	int nfingers;
-};
+	action = binding_lookup(GESTURE_SWIPE, sw->nfingers, direction);
+	if (action)
+		command_execute(action);
+}
 
-static void swipe_detected(struct swipe *sw, enum swipe_direction direction)
+static int swipe_begin(struct gesture *gest, const struct gesture_event *event)
 {
-	switch (direction) {
-	case SWIPE_UP:
-		syslog(LOG_INFO, "%s: UP fingers %d\n", __func__, sw->nfingers);
-		if (sw->nfingers == 3)
-			command_workspace_new();
-		break;
-	case SWIPE_DOWN:
-		syslog(LOG_INFO, "%s: DOWN finger %d\n", __func__, sw->nfingers);
-		if (sw->nfingers == 3)
-			command_workspace_back_and_forth();
-		break;
-	case SWIPE_LEFT:
-		syslog(LOG_INFO, "%s: LEFT fingers %d\n", __func__, sw->nfingers);
-		if (sw->nfingers == 3)
-			command_workspace_prev();
-		break;
-	case SWIPE_RIGHT:
-		syslog(LOG_INFO, "%s: RIGHT fingers %d\n", __func__, sw->nfingers);
-		if (sw->nfingers == 3)
-			command_workspace_next();
-		break;
-	default:
-		break;
-	};
+	int ret = 0;
+	struct swipe *sw = gesture_get_data(gest);
+
+	sw->nfingers = event->nfingers;
+
+	return ret;
 }
 
-static int swipe_begin(struct gesture *gest,
-		       struct libinput_event_gesture *li_gesture)
+/* travel beyond threshold along either axis, direction from the sectors */
+static bool swipe_classify(double dx, double dy, double threshold,
+			   bool strict, enum binding_direction *direction)
 {
-	int ret = 0;
-	struct swipe *sw = NULL;
+	const struct bindings *bindings = bindings_get();
+	int ret;
 
-	sw = calloc(1, sizeof(*sw));
-	if (!sw) {
-		ret = -ENOMEM;
-		goto exit;
+	if (!bindings || (fabs(dx) <= threshold && fabs(dy) <= threshold))
+		return false;
+
+	ret = sectors_classify(&bindings->sectors, dx, dy, strict);
+	if (ret < 0)
+		return false;
+
+	*direction = ret;
+	return true;
+}
+
+void swipe_track(struct swipe *sw, const struct gesture_event *event)
+{
+	struct swipe_sample *sample;
+
+	sw->dx += event->dx;
+	sw->dy += event->dy;
+
+	if (sw->count < SWIPE_FLING_SAMPLES) {
+		sample = &sw->samples[sw->count++];
+	} else {
+		sample = &sw->samples[sw->head];
+		sw->head = (sw->head + 1) % SWIPE_FLING_SAMPLES;
 	}
 
-	sw->nfingers = libinput_event_gesture_get_finger_count(li_gesture);
+	sample->dx = event->dx;
+	sample->dy = event->dy;
+	sample->time_usec = event->time_usec;
+}
 
-	gesture_set_data(gest, sw);
-exit:
-	return ret;
+/*
+ * Speed in units per msec over the updates of the last window before
+ * release. The delta of the oldest sample used happened before its
+ * timestamp, only the following ones count. 0 if the fingers stopped
+ * before being lifted.
+ */
+static double swipe_release_speed(struct swipe *sw, uint64_t end_usec)
+{
+	const struct swipe_sample *last, *sample;
+	double dx = 0, dy = 0;
+	uint32_t elapsed = 0;
+	int i, n;
+
+	if (sw->count < 2)
+		return 0;
+
+	last = &sw->samples[(sw->head + sw->count - 1) % SWIPE_FLING_SAMPLES];
+	if ((uint32_t)end_usec - last->time_usec > SWIPE_FLING_WINDOW_USEC)
+		return 0;
+
+	for (n = sw->count - 1; n > 0; n--) {
+		i = (sw->head + n) % SWIPE_FLING_SAMPLES;
+		sample = &sw->samples[(i + SWIPE_FLING_SAMPLES - 1) %
+				      SWIPE_FLING_SAMPLES];
+		if (last->time_usec - sample->time_usec >
+		    SWIPE_FLING_WINDOW_USEC)
+			break;
+
+		dx += sw->samples[i].dx;
+		dy += sw->samples[i].dy;
+		elapsed = last->time_usec - sample->time_usec;
+	}
+
+	if (!elapsed)
+		return 0;
+
+	return sqrt(dx * dx + dy * dy) * 1000 / elapsed;
 }
 
-static int swipe_update(struct gesture *gest,
-			struct libinput_event_gesture *li_gesture)
+/* short swipes released fast, classified on the whole travel */
+static bool swipe_fling(struct swipe *sw, uint64_t end_usec,
+			enum binding_direction *direction)
 {
-	int ret = 0;
-	struct swipe *sw = (struct swipe *)gesture_get_data(gest);
+	double speed;
+
+	if (!swipe_classify(sw->dx, sw->dy, SWIPE_FLING_DIST, false,
+			    direction))
+		return false;
+
+	speed = swipe_release_speed(sw, end_usec);
+	log_debug("%s: release speed %f\n", __func__, speed);
+
+	return speed >= SWIPE_FLING_SPEED;
+}
 
-	sw->dx += libinput_event_gesture_get_dx(li_gesture);
-	sw->dy += libinput_event_gesture_get_dy(li_gesture);
+bool swipe_recognize(struct swipe *sw, uint64_t end_usec,
+		     enum binding_direction *direction)
+{
+	return swipe_classify(sw->dx, sw->dy, SWIPE_DIST_THRESHOLD, false,
+			      direction) ||
+	       swipe_fling(sw, end_usec, direction);
+}
+
+static int swipe_update(struct gesture *gest, const struct gesture_event *event)
+{
+	int ret = 0;
+	struct swipe *sw = gesture_get_data(gest);
+	enum binding_direction direction;
+
+	/* direction is locked, ignore the rest of the gesture */
+	if (sw->fired)
+		return ret;
+
+	swipe_track(sw, event);
+
+	/* only once well within a sector, not to commit to a neighbour */
+	if (early_commit &&
+	    swipe_classify(sw->dx, sw->dy, SWIPE_DIST_THRESHOLD, true,
+			   &direction)) {
+		log_debug("%s: early commit dx %f dy %f\n", __func__,
+			  sw->dx, sw->dy);
+		sw->fired = true;
+		swipe_detected(sw, direction);
+	}
 
 	return ret;
 }
 
-static int swipe_end(struct gesture *gest,
-		     struct libinput_event_gesture *li_gesture)
+static int swipe_end(struct gesture *gest, const struct gesture_event *event)
 {
 	int ret = 0;
-	struct swipe *sw = (struct swipe *)gesture_get_data(gest);
-	double dx_abs = fabs(sw->dx);
-	double dy_abs = fabs(sw->dy);
-
-	syslog(LOG_DEBUG, "%s: dx %f dy %f\n", __func__, sw->dx, sw->dy);
-
-	if (dx_abs >= SWIPE_DIST_THRESHOLD &&
-	    dy_abs >= SWIPE_DIST_THRESHOLD) {
-		if ((dx_abs / dy_abs) > (dy_abs / dx_abs + OBLIQUE_RATIO)) {
-			/* horizontal swipe */
-			swipe_detected(sw, sw->dx > 0 ? SWIPE_RIGHT : SWIPE_LEFT);
-		} else if ((dy_abs / dx_abs) > (dx_abs / dy_abs + OBLIQUE_RATIO)) {
-			/* vertical swipe */
-			swipe_detected(sw, sw->dy > 0 ? SWIPE_DOWN : SWIPE_UP);
-		}
-	} else if (dx_abs > SWIPE_DIST_THRESHOLD) {
-		swipe_detected(sw, sw->dx > 0 ? SWIPE_RIGHT : SWIPE_LEFT);
-	} else if (dy_abs > SWIPE_DIST_THRESHOLD) {
-		swipe_detected(sw, sw->dy > 0 ? SWIPE_DOWN : SWIPE_UP);
+	struct swipe *sw = gesture_get_data(gest);
+	enum binding_direction direction;
+
+	log_debug("%s: dx %f dy %f\n", __func__, sw->dx, sw->dy);
+
+	if (sw->fired)
+		goto exit;
+
+	if (gesture_cancelled(event)) {
+		log_debug("%s: swipe cancelled\n", __func__);
+		goto exit;
 	}
 
-	free(sw);
+	if (swipe_recognize(sw, event->time_usec, &direction))
+		swipe_detected(sw, direction);
+
+exit:
 	return ret;
 }
 
@@ -121,3 +210,8 @@ struct gesture_ops *swipe_get_ops(void)
 {
 	return &swipe_ops;
 }
+
+void swipe_set_early_commit(bool enable)
+{
+	early_commit = enable;
+}
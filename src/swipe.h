@@ -0,0 +1,44 @@
+#ifndef _SWIPE_H_
+#define _SWIPE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "binding.h"
+
+/* shorter swipes still fire when released fast enough */
+#define SWIPE_FLING_DIST	30.0
+/* units per msec */
+#define SWIPE_FLING_SPEED	1.0
+/* release velocity is measured over the last updates within the window */
+#define SWIPE_FLING_WINDOW_USEC	50000
+#define SWIPE_FLING_SAMPLES	8
+
+struct swipe_sample {
+	float dx;
+	float dy;
+	/* low bits of the event timestamp, differences are what matter */
+	uint32_t time_usec;
+};
+
+/* travel of a stroke, also tracked by the shape recognizer */
+struct swipe {
+	double dx;
+	double dy;
+	int nfingers;
+	/* early commit: the action already fired during UPDATE */
+	bool fired;
+	/* ring of the last updates, oldest at head once full */
+	uint8_t head;
+	uint8_t count;
+	struct swipe_sample samples[SWIPE_FLING_SAMPLES];
+};
+
+void swipe_track(struct swipe *sw, const struct gesture_event *event);
+
+/* direction of a completed stroke, from its travel or a fling */
+bool swipe_recognize(struct swipe *sw, uint64_t end_usec,
+		     enum binding_direction *direction);
+void swipe_detected(struct swipe *sw, enum binding_direction direction);
+
+#endif
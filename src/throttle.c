@@ -0,0 +1,145 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "binding.h"
+#include "command.h"
+#include "log.h"
+#include "throttle.h"
+
+/* event timestamps may lag behind the clock read on replies */
+static bool throttle_elapsed(struct throttle *throttle, uint64_t now_usec)
+{
+	return (int64_t)(now_usec - throttle->last_usec) >=
+	       (int64_t)throttle->interval_usec;
+}
+
+static void throttle_emit(struct throttle *throttle, uint64_t now_usec);
+
+static void throttle_reply(const char *payload, uint32_t len, void *data)
+{
+	struct throttle *throttle = data;
+
+	throttle->inflight = false;
+	if (command_reply_ok(payload, len)) {
+		latency_stamp(&throttle->trace, LATENCY_REPLY);
+		latency_record(&throttle->trace);
+	}
+
+	if (throttle->draining) {
+		/* the gesture is over, this was its last command */
+		throttle->draining = false;
+		throttle_emit(throttle, latency_now());
+		throttle->active = false;
+	} else if (throttle->pending != 0 &&
+		   throttle_elapsed(throttle, latency_now())) {
+		throttle_emit(throttle, latency_now());
+	}
+}
+
+static void throttle_emit(struct throttle *throttle, uint64_t now_usec)
+{
+	const struct continuous_action *action = &throttle->action;
+	double amount = fabs(throttle->pending);
+	const char *format;
+	char cmd[128];
+	int ret;
+
+	if (!throttle->active || throttle->inflight || throttle->pending == 0 ||
+	    amount < action->min_step)
+		return;
+
+	format = throttle->pending > 0 ? action->increase : action->decrease;
+	throttle->pending = 0;
+	/* progress in the unbound direction is dropped */
+	if (!format[0])
+		return;
+
+	snprintf(cmd, sizeof(cmd), format, amount);
+
+	throttle->last_usec = now_usec;
+	throttle->inflight = true;
+
+	/* progress turns into an action as soon as it is sent */
+	throttle->trace = *latency_current();
+	throttle->trace.action = ACTION_CONTINUOUS;
+	latency_stamp(&throttle->trace, LATENCY_RECOGNIZE);
+	throttle->trace.usec[LATENCY_WRITE] =
+		throttle->trace.usec[LATENCY_RECOGNIZE];
+
+	ret = command_run(cmd, throttle_reply, throttle);
+	if (ret < 0)
+		throttle->inflight = false;
+}
+
+void throttle_start(struct throttle *throttle,
+		    const struct continuous_action *action)
+{
+	/* a command of the previous gesture may still be in flight */
+	throttle->action = *action;
+	throttle->active = true;
+	throttle->interval_usec = THROTTLE_INTERVAL_USEC;
+	throttle->pending = 0;
+	throttle->draining = false;
+}
+
+void throttle_update(struct throttle *throttle, double progress,
+		     uint64_t time_usec)
+{
+	if (!throttle->active)
+		return;
+
+	throttle->pending += progress * throttle->action.scale;
+
+	if (throttle_elapsed(throttle, time_usec))
+		throttle_emit(throttle, time_usec);
+}
+
+void throttle_end(struct throttle *throttle, bool cancelled)
+{
+	if (cancelled) {
+		log_debug("%s: dropping %f\n", __func__,
+			  throttle->pending);
+		throttle->pending = 0;
+		throttle->active = false;
+		return;
+	}
+
+	if (throttle->inflight) {
+		throttle->draining = true;
+		return;
+	}
+
+	throttle_emit(throttle, latency_now());
+	throttle->active = false;
+}
+
+bool throttle_format_valid(const char *format)
+{
+	const char *p;
+	int conversions = 0;
+
+	if (strlen(format) >= THROTTLE_FORMAT_SIZE)
+		return false;
+
+	for (p = strchr(format, '%'); p; p = strchr(p, '%')) {
+		p++;
+		if (*p == '%') {
+			p++;
+			continue;
+		}
+
+		/* optional precision only, no flags nor width */
+		if (*p == '.') {
+			p++;
+			while (*p >= '0' && *p <= '9')
+				p++;
+		}
+
+		if (!*p || !strchr("fgeFGE", *p))
+			return false;
+		conversions++;
+	}
+
+	return conversions == 1;
+}
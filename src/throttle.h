@@ -0,0 +1,54 @@
+#ifndef _THROTTLE_H_
+#define _THROTTLE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "latency.h"
+
+/* one frame at 60Hz */
+#define THROTTLE_INTERVAL_USEC	16667
+#define THROTTLE_FORMAT_SIZE	64
+
+/*
+ * Continuous action: gesture progress is scaled to an amount and sent as
+ * the 'increase' or 'decrease' sway command depending on its sign, both
+ * formatted with the absolute amount (a single double conversion).
+ */
+struct continuous_action {
+	char increase[THROTTLE_FORMAT_SIZE];
+	char decrease[THROTTLE_FORMAT_SIZE];
+	double scale;
+	/* smaller amounts are kept for the next command */
+	double min_step;
+};
+
+/*
+ * Rate limiter for continuous actions: progress of UPDATE events is
+ * accumulated and sent with at most one command in flight, and no more
+ * than one command per interval.
+ */
+struct throttle {
+	/* copied, commands in flight outlive the gesture and its binding */
+	struct continuous_action action;
+	bool active;
+	uint64_t interval_usec;
+	uint64_t last_usec;
+	double pending;
+	bool inflight;
+	/* gesture is over, send the rest once the command in flight is done */
+	bool draining;
+	/* of the command in flight */
+	struct latency_trace trace;
+};
+
+void throttle_start(struct throttle *throttle,
+		    const struct continuous_action *action);
+void throttle_update(struct throttle *throttle, double progress,
+		     uint64_t time_usec);
+void throttle_end(struct throttle *throttle, bool cancelled);
+
+/* checks a format takes exactly one double, e.g. "opacity plus %.2f" */
+bool throttle_format_valid(const char *format);
+
+#endif
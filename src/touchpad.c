@@ -0,0 +1,212 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "touchpad.h"
+
+struct touchpads {
+	struct udev_monitor *monitor;
+	struct libinput *li;
+	/* referenced, NULL for free slots */
+	struct libinput_device *devices[TOUCHPAD_MAX];
+};
+
+static bool touchpad_match(struct udev_device *dev)
+{
+	const char *value, *seat;
+
+	value = udev_device_get_property_value(dev, "ID_INPUT_TOUCHPAD");
+	if (!value || strcmp(value, "1"))
+		return false;
+
+	/* event nodes only, not the parent input device */
+	if (!udev_device_get_devnode(dev) ||
+	    strncmp(udev_device_get_sysname(dev), "event", 5))
+		return false;
+
+	/* udev leaves ID_SEAT unset for the default seat */
+	seat = udev_device_get_property_value(dev, "ID_SEAT");
+	return !seat || !strcmp(seat, "seat0");
+}
+
+static void touchpad_add(struct touchpads *tps, struct udev_device *dev)
+{
+	struct libinput_device *device;
+	const char *devnode = udev_device_get_devnode(dev);
+	const char *sysname = udev_device_get_sysname(dev);
+	int i, slot = -1;
+
+	for (i = 0; i < TOUCHPAD_MAX; i++) {
+		if (!tps->devices[i]) {
+			if (slot < 0)
+				slot = i;
+			continue;
+		}
+
+		/* both scanned and reported by the monitor, or re-triggered */
+		if (!strcmp(libinput_device_get_sysname(tps->devices[i]),
+			    sysname)) {
+			log_debug("%s: %s already open\n", __func__, devnode);
+			return;
+		}
+	}
+
+	if (slot < 0) {
+		log_err("Too many touchpads, ignoring %s\n", devnode);
+		return;
+	}
+
+	device = libinput_path_add_device(tps->li, devnode);
+	if (!device) {
+		log_err("Failed to open touchpad %s\n", devnode);
+		return;
+	}
+
+	/* touchpads without gesture support are of no use */
+	if (!libinput_device_has_capability(device,
+					    LIBINPUT_DEVICE_CAP_GESTURE)) {
+		log_debug("%s: %s has no gesture support\n", __func__,
+			  devnode);
+		libinput_path_remove_device(device);
+		return;
+	}
+
+	log_info("Using touchpad %s (%s)\n", devnode,
+		 libinput_device_get_name(device));
+	tps->devices[slot] = libinput_device_ref(device);
+}
+
+static void touchpad_remove(struct touchpads *tps, struct udev_device *dev)
+{
+	const char *sysname = udev_device_get_sysname(dev);
+	int i;
+
+	for (i = 0; i < TOUCHPAD_MAX; i++) {
+		if (!tps->devices[i] ||
+		    strcmp(libinput_device_get_sysname(tps->devices[i]),
+			   sysname))
+			continue;
+
+		/* its gesture in progress is cancelled on DEVICE_REMOVED */
+		log_info("Touchpad %s removed\n", sysname);
+		libinput_path_remove_device(tps->devices[i]);
+		libinput_device_unref(tps->devices[i]);
+		tps->devices[i] = NULL;
+		return;
+	}
+}
+
+static int touchpads_scan(struct touchpads *tps, struct udev *udev)
+{
+	struct udev_enumerate *enumerate;
+	struct udev_list_entry *entry;
+	struct udev_device *dev;
+	int ret = 0;
+
+	enumerate = udev_enumerate_new(udev);
+	if (!enumerate)
+		return -ENOMEM;
+
+	udev_enumerate_add_match_subsystem(enumerate, "input");
+	udev_enumerate_add_match_property(enumerate, "ID_INPUT_TOUCHPAD", "1");
+	ret = udev_enumerate_scan_devices(enumerate);
+	if (ret < 0) {
+		log_err("Failed to enumerate input devices: %s\n",
+			strerror(-ret));
+		goto exit;
+	}
+
+	udev_list_entry_foreach(entry,
+				udev_enumerate_get_list_entry(enumerate)) {
+		dev = udev_device_new_from_syspath(udev,
+				udev_list_entry_get_name(entry));
+		if (!dev)
+			continue;
+
+		if (touchpad_match(dev))
+			touchpad_add(tps, dev);
+		udev_device_unref(dev);
+	}
+
+exit:
+	udev_enumerate_unref(enumerate);
+	return ret;
+}
+
+struct touchpads *touchpads_new(struct udev *udev, struct libinput *li)
+{
+	struct touchpads *tps;
+	int ret;
+
+	tps = calloc(1, sizeof(*tps));
+	if (!tps)
+		return NULL;
+	tps->li = li;
+
+	/* listen before scanning so that no touchpad slips in between */
+	tps->monitor = udev_monitor_new_from_netlink(udev, "udev");
+	if (!tps->monitor) {
+		log_err("Failed to create udev monitor\n");
+		goto exit;
+	}
+
+	ret = udev_monitor_filter_add_match_subsystem_devtype(tps->monitor,
+							      "input", NULL);
+	if (ret >= 0)
+		ret = udev_monitor_enable_receiving(tps->monitor);
+	if (ret < 0) {
+		log_err("Failed to monitor input devices: %s\n",
+			strerror(-ret));
+		goto exit;
+	}
+
+	if (touchpads_scan(tps, udev) < 0)
+		goto exit;
+
+	return tps;
+exit:
+	touchpads_destroy(tps);
+	return NULL;
+}
+
+void touchpads_destroy(struct touchpads *tps)
+{
+	int i;
+
+	if (!tps)
+		return;
+
+	for (i = 0; i < TOUCHPAD_MAX; i++)
+		if (tps->devices[i])
+			libinput_device_unref(tps->devices[i]);
+	udev_monitor_unref(tps->monitor);
+	free(tps);
+}
+
+int touchpads_get_fd(struct touchpads *tps)
+{
+	return tps ? udev_monitor_get_fd(tps->monitor) : -1;
+}
+
+void touchpads_dispatch(struct touchpads *tps)
+{
+	struct udev_device *dev;
+	const char *action;
+
+	while ((dev = udev_monitor_receive_device(tps->monitor))) {
+		action = udev_device_get_action(dev);
+		if (!action) {
+			udev_device_unref(dev);
+			continue;
+		}
+
+		if (!strcmp(action, "add") && touchpad_match(dev))
+			touchpad_add(tps, dev);
+		else if (!strcmp(action, "remove"))
+			touchpad_remove(tps, dev);
+
+		udev_device_unref(dev);
+	}
+}
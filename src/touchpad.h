@@ -0,0 +1,25 @@
+#ifndef _TOUCHPAD_H_
+#define _TOUCHPAD_H_
+
+#include <libinput.h>
+
+#include <libudev.h>
+
+/* touchpads tracked at once */
+#define TOUCHPAD_MAX	8
+
+struct touchpads;
+
+/*
+ * Feed a libinput path context with the touchpads of seat0 only, so that
+ * keyboards and mice never wake swayped up. Touchpads plugged in later are
+ * added through a udev monitor, see touchpads_get_fd().
+ */
+struct touchpads *touchpads_new(struct udev *udev, struct libinput *li);
+void touchpads_destroy(struct touchpads *tps);
+
+/* udev monitor, touchpads_dispatch() once readable */
+int touchpads_get_fd(struct touchpads *tps);
+void touchpads_dispatch(struct touchpads *tps);
+
+#endif
@@ -0,0 +1,319 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sway/ipc-client.h"
+
+#include "connection.h"
+#include "json-scan.h"
+#include "log.h"
+#include "workspace.h"
+
+#define WORKSPACE_WORDS	(WORKSPACE_MAX / 64)
+
+static struct {
+	/* one bit per existing workspace number */
+	uint64_t bits[WORKSPACE_WORDS];
+	/* hash of the output name of each workspace */
+	uint32_t output[WORKSPACE_MAX];
+	/* named workspaces, or numbered out of the bitset range */
+	int untracked;
+	int focused;
+	bool subscribed;
+	bool synced;
+	/* a resync is already queued, no need for another one */
+	bool syncing;
+} cache;
+
+static int bits_last(const uint64_t *bits)
+{
+	int i;
+
+	for (i = WORKSPACE_WORDS - 1; i >= 0; i--)
+		if (bits[i])
+			return i * 64 + 63 - __builtin_clzll(bits[i]);
+
+	return -1;
+}
+
+static int bits_first_free(const uint64_t *bits)
+{
+	int i;
+
+	/* workspace numbers start at 1 */
+	for (i = 0; i < WORKSPACE_WORDS; i++) {
+		uint64_t free_bits = ~bits[i];
+
+		if (i == 0)
+			free_bits &= ~UINT64_C(1);
+		if (free_bits)
+			return i * 64 + __builtin_ctzll(free_bits);
+	}
+
+	return -1;
+}
+
+static bool workspace_has(int num)
+{
+	return num >= 0 && num < WORKSPACE_MAX &&
+	       cache.bits[num / 64] & (UINT64_C(1) << (num % 64));
+}
+
+/* FNV-1a, output names are only compared with each other */
+static uint32_t workspace_output_hash(const struct json_span *workspace)
+{
+	struct json_span value, name;
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	if (!json_scan_get(workspace, "output", &value) ||
+	    !json_scan_string(&value, &name))
+		return 0;
+
+	for (i = 0; i < name.len; i++)
+		hash = (hash ^ (unsigned char)name.start[i]) * 16777619u;
+
+	return hash;
+}
+
+static void workspace_set(int num, bool present, uint32_t output)
+{
+	if (num < 0 || num >= WORKSPACE_MAX) {
+		log_debug("%s: workspace %d not tracked\n",
+			  __func__, num);
+		cache.untracked += present ? 1 : -1;
+		return;
+	}
+
+	if (present) {
+		cache.bits[num / 64] |= UINT64_C(1) << (num % 64);
+		cache.output[num] = output;
+	} else {
+		cache.bits[num / 64] &= ~(UINT64_C(1) << (num % 64));
+	}
+}
+
+static void workspace_sync_reply(const char *payload, uint32_t len,
+				 void *data)
+{
+	struct json_span reply = { payload, len };
+	struct json_span json_workspace;
+	struct json_scan it;
+	bool focused;
+	int num;
+
+	cache.syncing = false;
+
+	if (!payload)
+		return;
+
+	if (!json_scan_array(&it, &reply)) {
+		log_err("Failed to parse workspaces list\n");
+		return;
+	}
+
+	memset(cache.bits, 0, sizeof(cache.bits));
+	cache.untracked = 0;
+	while (json_scan_array_next(&it, &json_workspace)) {
+		if (!json_scan_get_int(&json_workspace, "num", &num))
+			continue;
+
+		workspace_set(num, true, workspace_output_hash(&json_workspace));
+
+		if (json_scan_get_bool(&json_workspace, "focused", &focused) &&
+		    focused)
+			cache.focused = num;
+	}
+
+	cache.synced = true;
+	log_debug("%s: focused workspace %d, last %d\n", __func__,
+		  cache.focused, workspace_last());
+}
+
+static void workspace_sync(struct connection *conn)
+{
+	int ret;
+
+	if (cache.syncing)
+		return;
+
+	ret = connection_send(conn, IPC_GET_WORKSPACES, "", 0,
+			      workspace_sync_reply, NULL);
+	if (ret < 0) {
+		log_err("Failed to query sway workspaces: %s\n",
+			strerror(-ret));
+		cache.synced = false;
+		return;
+	}
+
+	cache.syncing = true;
+}
+
+static void workspace_subscribe_reply(const char *payload, uint32_t len,
+				      void *data)
+{
+	struct json_span reply = { payload, len };
+	bool success = false;
+
+	if (!payload)
+		return;
+
+	json_scan_get_bool(&reply, "success", &success);
+	cache.subscribed = success;
+
+	if (!cache.subscribed)
+		log_err("Failed to subscribe to workspace events\n");
+}
+
+static void workspace_connected(struct connection *conn, void *data)
+{
+	static const char subscribe[] = "[\"workspace\"]";
+	int ret;
+
+	ret = connection_send(conn, IPC_SUBSCRIBE, subscribe,
+			      sizeof(subscribe) - 1,
+			      workspace_subscribe_reply, NULL);
+	if (ret < 0) {
+		log_err("Failed to subscribe to workspace events: %s\n",
+			strerror(-ret));
+		return;
+	}
+
+	/* events received from now on apply on top of this state */
+	workspace_sync(conn);
+}
+
+static void workspace_disconnected(struct connection *conn, void *data)
+{
+	cache.subscribed = false;
+	cache.synced = false;
+}
+
+static void workspace_event(struct connection *conn, uint32_t type,
+			    const char *payload, uint32_t len, void *data)
+{
+	struct json_span event = { payload, len };
+	struct json_span change, current = { "", 0 };
+	int num = -1;
+
+	if (type != IPC_EVENT_WORKSPACE)
+		return;
+
+	if (!json_scan_get(&event, "change", &change))
+		return;
+
+	if (json_scan_get(&event, "current", &current))
+		json_scan_get_int(&current, "num", &num);
+
+	if (json_scan_string_eq(&change, "init")) {
+		workspace_set(num, true, workspace_output_hash(&current));
+	} else if (json_scan_string_eq(&change, "empty")) {
+		workspace_set(num, false, 0);
+	} else if (json_scan_string_eq(&change, "focus")) {
+		cache.focused = num;
+	} else if (json_scan_string_eq(&change, "rename") ||
+		   json_scan_string_eq(&change, "move") ||
+		   json_scan_string_eq(&change, "reload")) {
+		/* numbers may have changed, events do not tell the old one */
+		workspace_sync(conn);
+	}
+}
+
+static const struct connection_ops workspace_ops = {
+	.connected    = workspace_connected,
+	.disconnected = workspace_disconnected,
+	.event        = workspace_event,
+};
+
+void workspace_init(struct connection *conn)
+{
+	connection_set_ops(conn, &workspace_ops, NULL);
+}
+
+bool workspace_cache_valid(void)
+{
+	return cache.subscribed && cache.synced;
+}
+
+int workspace_last(void)
+{
+	return bits_last(cache.bits);
+}
+
+int workspace_first_free(void)
+{
+	return bits_first_free(cache.bits);
+}
+
+bool workspace_scan(const char *payload, uint32_t len, int *last,
+		    int *first_free)
+{
+	struct json_span reply = { payload, len };
+	struct json_span json_workspace;
+	struct json_scan it;
+	uint64_t bits[WORKSPACE_WORDS] = { 0 };
+	int num;
+
+	if (!json_scan_array(&it, &reply))
+		return false;
+
+	while (json_scan_array_next(&it, &json_workspace))
+		if (json_scan_get_int(&json_workspace, "num", &num) &&
+		    num >= 0 && num < WORKSPACE_MAX)
+			bits[num / 64] |= UINT64_C(1) << (num % 64);
+
+	*last = bits_last(bits);
+	*first_free = bits_first_free(bits);
+	return true;
+}
+
+int workspace_focused(void)
+{
+	return workspace_has(cache.focused) ? cache.focused : -1;
+}
+
+int workspace_count(void)
+{
+	int i, count = cache.untracked;
+
+	for (i = 0; i < WORKSPACE_WORDS; i++)
+		count += __builtin_popcountll(cache.bits[i]);
+
+	return count;
+}
+
+bool workspace_ordered(void)
+{
+	int num, first = -1;
+
+	if (!workspace_cache_valid() || cache.untracked)
+		return false;
+
+	for (num = 0; num < WORKSPACE_MAX; num++) {
+		if (!workspace_has(num))
+			continue;
+		if (first < 0)
+			first = num;
+		else if (cache.output[num] != cache.output[first])
+			return false;
+	}
+
+	return true;
+}
+
+int workspace_step(int num, int steps)
+{
+	int dir = steps > 0 ? 1 : -1;
+
+	if (!workspace_has(num))
+		return -1;
+
+	while (steps) {
+		do
+			num = (num + dir + WORKSPACE_MAX) % WORKSPACE_MAX;
+		while (!workspace_has(num));
+		steps -= dir;
+	}
+
+	return num;
+}
@@ -0,0 +1,38 @@
+#ifndef _WORKSPACE_H_
+#define _WORKSPACE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* workspace numbers tracked by the cache, others are ignored */
+#define WORKSPACE_MAX	256
+
+struct connection;
+
+/* keep the cache up to date from sway workspace events */
+void workspace_init(struct connection *conn);
+
+/* false until sway acknowledged the subscription and sent its state */
+bool workspace_cache_valid(void);
+
+/* highest existing and lowest unused numbers, -1 if unknown */
+int workspace_last(void);
+int workspace_first_free(void);
+
+/* same from a GET_WORKSPACES reply, for when the cache is not valid */
+bool workspace_scan(const char *payload, uint32_t len, int *last,
+		    int *first_free);
+
+int workspace_focused(void);
+int workspace_count(void);
+
+/*
+ * sway walks workspaces output by output: with a single output and only
+ * numbered workspaces, 'workspace next' follows the numbers.
+ */
+bool workspace_ordered(void);
+
+/* n-th workspace after (steps > 0) or before num, wrapping around */
+int workspace_step(int num, int steps);
+
+#endif
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "binding.h"
+#include "command.h"
+#include "latency.h"
+
+#include "fake-command.h"
+
+#define FAKE_COMMAND_INFLIGHT	32
+
+static const char reply_success[] = "[{\"success\": true}]";
+
+static struct {
+	FILE *output;
+	unsigned long count;
+
+	struct {
+		connection_reply_cb cb;
+		void *data;
+	} inflight[FAKE_COMMAND_INFLIGHT];
+	unsigned int ninflight;
+} sink;
+
+static void fake_command_print(const char *fmt, const char *arg)
+{
+	sink.count++;
+	if (!sink.output)
+		return;
+
+	fprintf(sink.output, "%llu ", (unsigned long long)latency_now());
+	fprintf(sink.output, fmt, arg);
+	fputc('\n', sink.output);
+}
+
+void fake_command_set_output(FILE *output)
+{
+	sink.output = output;
+}
+
+void fake_command_complete(void)
+{
+	unsigned int i, n = sink.ninflight;
+
+	/* callbacks may run new commands */
+	sink.ninflight = 0;
+	for (i = 0; i < n; i++)
+		sink.inflight[i].cb(reply_success, strlen(reply_success),
+				    sink.inflight[i].data);
+}
+
+unsigned long fake_command_count(void)
+{
+	return sink.count;
+}
+
+void command_execute(const struct action *action)
+{
+	switch (action->type) {
+	case ACTION_WORKSPACE_NEXT:
+		fake_command_print("%s", "workspace next");
+		break;
+	case ACTION_WORKSPACE_PREV:
+		fake_command_print("%s", "workspace prev");
+		break;
+	case ACTION_WORKSPACE_BACK_AND_FORTH:
+		fake_command_print("%s", "workspace back_and_forth");
+		break;
+	case ACTION_WORKSPACE_NEW:
+		fake_command_print("%s", "new_workspace");
+		break;
+	case ACTION_WORKSPACE_NEW_LOWEST:
+		fake_command_print("%s", "new_workspace lowest");
+		break;
+	case ACTION_COMMAND:
+		fake_command_print("%s", action->command);
+		break;
+	case ACTION_SPAWN:
+		/* nothing is started, the program name is enough */
+		fake_command_print("spawn %s", action->command);
+		break;
+	default:
+		break;
+	}
+}
+
+int command_run(const char *cmd, connection_reply_cb cb, void *data)
+{
+	if (sink.ninflight == FAKE_COMMAND_INFLIGHT)
+		return -1;
+
+	fake_command_print("run %s", cmd);
+	sink.inflight[sink.ninflight].cb = cb;
+	sink.inflight[sink.ninflight].data = data;
+	sink.ninflight++;
+	return 0;
+}
+
+bool command_reply_ok(const char *payload, uint32_t len)
+{
+	return payload != NULL;
+}
@@ -0,0 +1,20 @@
+#ifndef _FAKE_COMMAND_H_
+#define _FAKE_COMMAND_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/*
+ * Command sink standing in for command.c: actions are printed instead of
+ * being sent to sway, commands run with command_run() are acknowledged by
+ * fake_command_complete().
+ */
+void fake_command_set_output(FILE *output);
+
+/* reply success to the commands run so far */
+void fake_command_complete(void);
+
+/* actions and commands received */
+unsigned long fake_command_count(void);
+
+#endif
@@ -0,0 +1,305 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sway/ipc-client.h"
+
+#include "command.h"
+#include "connection.h"
+#include "log.h"
+
+/*
+ * Sends requests to sway, or to mock-sway, through the swayped client code
+ * and reports round-trip latency and throughput.
+ */
+
+struct load {
+	uint32_t type;
+	const char *payload;
+	unsigned long count;
+	/* requests per second, 0 for as fast as possible */
+	unsigned long rate;
+	/* async: requests in flight */
+	unsigned int depth;
+
+	uint64_t *samples;
+	unsigned long sent;
+	unsigned long done;
+	unsigned long failed;
+	unsigned int inflight;
+};
+
+struct request {
+	struct load *load;
+	uint64_t start_nsec;
+};
+
+static uint64_t clock_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* when request n is due, 0 if it can be sent right away */
+static uint64_t load_due(struct load *load, uint64_t start_nsec)
+{
+	if (!load->rate)
+		return 0;
+
+	return start_nsec + load->sent * 1000000000ull / load->rate;
+}
+
+static int load_sync(struct load *load)
+{
+	uint64_t start_nsec, due_nsec, now_nsec;
+	/* reused by every reply, no allocation per request */
+	struct ipc_buffer buf = { 0 };
+	char *socket_path, *reply;
+	uint32_t len;
+	int fd;
+
+	socket_path = get_socketpath();
+	if (!socket_path) {
+		fprintf(stderr, "No sway socket, set SWAYSOCK\n");
+		return -1;
+	}
+
+	fd = ipc_open_socket(socket_path);
+	free(socket_path);
+	if (fd < 0)
+		return -1;
+
+	start_nsec = clock_nsec();
+	while (load->sent < load->count) {
+		due_nsec = load_due(load, start_nsec);
+		now_nsec = clock_nsec();
+		if (due_nsec > now_nsec)
+			usleep((due_nsec - now_nsec) / 1000);
+
+		now_nsec = clock_nsec();
+		len = strlen(load->payload);
+		load->sent++;
+		reply = ipc_single_command_into(fd, &buf, load->type,
+						load->payload, &len);
+		if (!reply) {
+			load->failed++;
+			break;
+		}
+		load->samples[load->done++] = clock_nsec() - now_nsec;
+	}
+
+	ipc_buffer_finish(&buf);
+	close(fd);
+	return 0;
+}
+
+static void load_reply(const char *payload, uint32_t len, void *data)
+{
+	struct request *request = data;
+	struct load *load = request->load;
+
+	load->inflight--;
+	if (!payload || (load->type == IPC_COMMAND &&
+			 !command_reply_ok(payload, len)))
+		load->failed++;
+	else
+		load->samples[load->done++] = clock_nsec() - request->start_nsec;
+
+	free(request);
+}
+
+static int load_send(struct load *load, struct connection *conn)
+{
+	struct request *request;
+	int ret;
+
+	request = calloc(1, sizeof(*request));
+	if (!request)
+		return -ENOMEM;
+	request->load = load;
+	request->start_nsec = clock_nsec();
+
+	load->sent++;
+	load->inflight++;
+	/* commands take the same path as swayped's throttled actions */
+	if (load->type == IPC_COMMAND)
+		ret = command_run(load->payload, load_reply, request);
+	else
+		ret = connection_send(conn, load->type, load->payload,
+				      strlen(load->payload), load_reply,
+				      request);
+
+	/* only requests that were queued get a reply */
+	if (ret < 0) {
+		load->sent--;
+		load->inflight--;
+		free(request);
+	}
+
+	return ret;
+}
+
+static int load_async(struct load *load)
+{
+	struct connection *conn;
+	struct pollfd pfd;
+	uint64_t start_nsec, due_nsec, now_nsec;
+	int timeout, ret = 0;
+
+	conn = connection_new();
+	if (!conn)
+		return -1;
+	command_init(conn);
+
+	ret = connection_connect(conn);
+	if (ret < 0)
+		goto exit;
+
+	start_nsec = clock_nsec();
+	while (load->done + load->failed < load->count) {
+		timeout = -1;
+		while (load->sent < load->count &&
+		       load->inflight < load->depth) {
+			due_nsec = load_due(load, start_nsec);
+			now_nsec = clock_nsec();
+			if (due_nsec > now_nsec) {
+				timeout = (due_nsec - now_nsec) / 1000000 + 1;
+				break;
+			}
+
+			ret = load_send(load, conn);
+			if (ret < 0)
+				goto exit;
+		}
+
+		pfd.fd = connection_get_fd(conn);
+		pfd.events = connection_get_events(conn);
+		if (pfd.fd < 0) {
+			ret = -ENOTCONN;
+			goto exit;
+		}
+
+		ret = poll(&pfd, 1, timeout);
+		if (ret < 0 && errno != EINTR)
+			goto exit;
+		if (ret > 0)
+			connection_dispatch(conn, pfd.revents);
+		ret = 0;
+		log_flush();
+	}
+
+exit:
+	connection_destroy(conn);
+	return ret;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double percentile_usec(const struct load *load, unsigned int percent)
+{
+	unsigned long rank;
+
+	if (!load->done)
+		return 0;
+
+	rank = (load->done * percent + 99) / 100;
+	return load->samples[rank ? rank - 1 : 0] / 1000.0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-a depth] [-n count] [-r rate] "
+		"[-t command|workspaces] [payload]\n"
+		"  -a  pipeline depth through the async connection, "
+		"0 for the blocking client\n"
+		"  -n  number of requests\n"
+		"  -r  requests per second, as fast as possible by default\n"
+		"  -t  request type, command by default\n"
+		"payload defaults to 'nop' for commands\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	struct load load = {
+		.type = IPC_COMMAND,
+		.count = 10000,
+		.depth = 4,
+	};
+	uint64_t start_nsec, elapsed_nsec;
+	int opt, ret;
+
+	openlog("ipc-load", LOG_PERROR, LOG_USER);
+
+	while ((opt = getopt(argc, argv, "a:n:r:t:h")) != -1) {
+		switch (opt) {
+		case 'a':
+			load.depth = strtoul(optarg, NULL, 10);
+			break;
+		case 'n':
+			load.count = strtoul(optarg, NULL, 10);
+			break;
+		case 'r':
+			load.rate = strtoul(optarg, NULL, 10);
+			break;
+		case 't':
+			if (!strcmp(optarg, "command")) {
+				load.type = IPC_COMMAND;
+			} else if (!strcmp(optarg, "workspaces")) {
+				load.type = IPC_GET_WORKSPACES;
+			} else {
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'h':
+			usage(argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (load.depth > CONNECTION_QUEUE_SIZE)
+		load.depth = CONNECTION_QUEUE_SIZE;
+
+	if (optind < argc)
+		load.payload = argv[optind];
+	else
+		load.payload = load.type == IPC_COMMAND ? "nop" : "";
+
+	load.samples = calloc(load.count ? load.count : 1,
+			      sizeof(*load.samples));
+	if (!load.samples)
+		return EXIT_FAILURE;
+
+	start_nsec = clock_nsec();
+	ret = load.depth ? load_async(&load) : load_sync(&load);
+	elapsed_nsec = clock_nsec() - start_nsec;
+	log_flush();
+
+	qsort(load.samples, load.done, sizeof(*load.samples), compare_u64);
+
+	printf("%lu requests, %lu failed, %.0f req/s\n", load.done, load.failed,
+	       elapsed_nsec ? load.done * 1e9 / elapsed_nsec : 0.0);
+	printf("round trip: p50 %.1fus p90 %.1fus p99 %.1fus max %.1fus\n",
+	       percentile_usec(&load, 50), percentile_usec(&load, 90),
+	       percentile_usec(&load, 99), percentile_usec(&load, 100));
+
+	free(load.samples);
+	return ret < 0 || load.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,440 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "sway/ipc-client.h"
+
+/*
+ * Stand-in for sway on a Unix socket: answers IPC_COMMAND, IPC_GET_WORKSPACES
+ * and IPC_SUBSCRIBE, follows workspace switches and sends workspace events
+ * to subscribers, as swayped expects from sway.
+ */
+
+#define MOCK_MAX_CLIENTS	16
+#define MOCK_MAX_WORKSPACES	4096
+
+struct client {
+	int fd;
+	bool subscribed;
+	char *buf;
+	size_t len;
+	size_t size;
+};
+
+struct buffer {
+	char *data;
+	size_t len;
+	size_t size;
+};
+
+static struct {
+	/* workspace exists, created ones are destroyed once left */
+	bool exists[MOCK_MAX_WORKSPACES];
+	bool created[MOCK_MAX_WORKSPACES];
+	int focused;
+	int previous;
+	int outputs;
+	/* extra bytes per workspace in GET_WORKSPACES replies */
+	size_t filler;
+	/* before each reply */
+	unsigned int delay_usec;
+	bool verbose;
+
+	struct client clients[MOCK_MAX_CLIENTS];
+	int nclients;
+	unsigned long messages;
+} mock;
+
+static void buffer_printf(struct buffer *buf, const char *fmt, ...)
+{
+	va_list args;
+	int len;
+
+	for (;;) {
+		va_start(args, fmt);
+		len = vsnprintf(buf->data + buf->len, buf->size - buf->len,
+				fmt, args);
+		va_end(args);
+
+		if (len >= 0 && (size_t)len < buf->size - buf->len)
+			break;
+
+		buf->size = buf->size ? buf->size * 2 : 4096;
+		if ((size_t)len >= buf->size)
+			buf->size = len + buf->len + 1;
+		buf->data = realloc(buf->data, buf->size);
+		if (!buf->data)
+			abort();
+	}
+
+	buf->len += len;
+}
+
+static int send_message(int fd, uint32_t type, const char *payload,
+			uint32_t len)
+{
+	char header[IPC_HEADER_SIZE];
+	struct iovec iov[2] = {
+		{ header, sizeof(header) },
+		{ (void *)payload, len },
+	};
+	struct msghdr msg = { .msg_iov = iov, .msg_iovlen = 2 };
+	ssize_t ret;
+
+	ipc_header_encode(header, type, len);
+
+	while (iov[0].iov_len || iov[1].iov_len) {
+		ret = sendmsg(fd, &msg, MSG_NOSIGNAL);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+
+		/* skip what was sent */
+		while (ret > 0 && msg.msg_iovlen) {
+			size_t n = (size_t)ret < msg.msg_iov->iov_len ?
+				   (size_t)ret : msg.msg_iov->iov_len;
+
+			msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + n;
+			msg.msg_iov->iov_len -= n;
+			ret -= n;
+			if (!msg.msg_iov->iov_len) {
+				msg.msg_iov++;
+				msg.msg_iovlen--;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void workspace_json(struct buffer *buf, int num)
+{
+	buffer_printf(buf, "{\"num\": %d, \"name\": \"%d\", "
+		      "\"focused\": %s, \"visible\": %s, "
+		      "\"output\": \"MOCK-%d\", \"representation\": \"%*s\"}",
+		      num, num, num == mock.focused ? "true" : "false",
+		      num == mock.focused ? "true" : "false",
+		      num % mock.outputs, (int)mock.filler, "");
+}
+
+static void broadcast_event(const char *change, int num)
+{
+	struct buffer buf = { 0 };
+	int i;
+
+	buffer_printf(&buf, "{\"change\": \"%s\", \"current\": ", change);
+	workspace_json(&buf, num);
+	buffer_printf(&buf, "}");
+
+	for (i = 0; i < mock.nclients; i++)
+		if (mock.clients[i].subscribed)
+			send_message(mock.clients[i].fd, IPC_EVENT_WORKSPACE,
+				     buf.data, buf.len);
+
+	free(buf.data);
+}
+
+static int workspace_neighbour(int num, int dir)
+{
+	int i, n = num;
+
+	for (i = 1; i < MOCK_MAX_WORKSPACES; i++) {
+		n = (n + dir + MOCK_MAX_WORKSPACES) % MOCK_MAX_WORKSPACES;
+		if (mock.exists[n])
+			return n;
+	}
+
+	return num;
+}
+
+static void workspace_focus(int num)
+{
+	int old = mock.focused;
+
+	if (num <= 0 || num >= MOCK_MAX_WORKSPACES || num == old)
+		return;
+
+	if (!mock.exists[num]) {
+		mock.exists[num] = true;
+		mock.created[num] = true;
+		broadcast_event("init", num);
+	}
+
+	mock.focused = num;
+	mock.previous = old;
+	broadcast_event("focus", num);
+
+	/* sway destroys the empty workspace it leaves */
+	if (mock.created[old]) {
+		mock.exists[old] = false;
+		mock.created[old] = false;
+		broadcast_event("empty", old);
+	}
+}
+
+static void run_command(char *cmd)
+{
+	int num;
+
+	while (*cmd == ' ')
+		cmd++;
+
+	if (sscanf(cmd, "workspace number %d", &num) == 1 ||
+	    sscanf(cmd, "workspace %d", &num) == 1)
+		workspace_focus(num);
+	else if (!strcmp(cmd, "workspace next"))
+		workspace_focus(workspace_neighbour(mock.focused, 1));
+	else if (!strcmp(cmd, "workspace prev"))
+		workspace_focus(workspace_neighbour(mock.focused, -1));
+	else if (!strcmp(cmd, "workspace back_and_forth"))
+		workspace_focus(mock.previous);
+}
+
+static void handle_message(struct client *client, uint32_t type,
+			   char *payload)
+{
+	struct buffer buf = { 0 };
+	char *cmd, *save = NULL;
+	int i;
+
+	mock.messages++;
+	if (mock.verbose)
+		fprintf(stderr, "type %u: %s\n", type, payload);
+
+	if (mock.delay_usec)
+		usleep(mock.delay_usec);
+
+	switch (type) {
+	case IPC_COMMAND:
+		/* one result per ';' separated command */
+		buffer_printf(&buf, "[");
+		for (cmd = strtok_r(payload, ";", &save); cmd;
+		     cmd = strtok_r(NULL, ";", &save)) {
+			run_command(cmd);
+			buffer_printf(&buf, "%s{\"success\": true}",
+				      buf.len > 1 ? ", " : "");
+		}
+		buffer_printf(&buf, "]");
+		break;
+
+	case IPC_GET_WORKSPACES:
+		buffer_printf(&buf, "[");
+		for (i = 0; i < MOCK_MAX_WORKSPACES; i++) {
+			if (!mock.exists[i])
+				continue;
+			if (buf.len > 1)
+				buffer_printf(&buf, ", ");
+			workspace_json(&buf, i);
+		}
+		buffer_printf(&buf, "]");
+		break;
+
+	case IPC_SUBSCRIBE:
+		client->subscribed = strstr(payload, "\"workspace\"") != NULL;
+		buffer_printf(&buf, "{\"success\": %s}",
+			      client->subscribed ? "true" : "false");
+		break;
+
+	default:
+		buffer_printf(&buf, "{\"success\": false, "
+			      "\"error\": \"not supported by mock-sway\"}");
+		break;
+	}
+
+	send_message(client->fd, type, buf.data, buf.len);
+	free(buf.data);
+}
+
+static void client_remove(int index)
+{
+	struct client *client = &mock.clients[index];
+
+	close(client->fd);
+	free(client->buf);
+	mock.clients[index] = mock.clients[--mock.nclients];
+}
+
+/* returns false once the client is gone */
+static bool client_read(struct client *client)
+{
+	uint32_t type, len;
+	char saved;
+	ssize_t ret;
+
+	if (client->size - client->len < 4096) {
+		client->size = client->size ? client->size * 2 : 8192;
+		client->buf = realloc(client->buf, client->size);
+		if (!client->buf)
+			abort();
+	}
+
+	ret = recv(client->fd, client->buf + client->len,
+		   client->size - client->len - 1, 0);
+	if (ret <= 0)
+		return ret < 0 && errno == EINTR;
+	client->len += ret;
+
+	while (client->len >= IPC_HEADER_SIZE) {
+		if (!ipc_header_decode(client->buf, &type, &len))
+			return false;
+		if (client->len - IPC_HEADER_SIZE < len)
+			break;
+
+		memmove(client->buf, client->buf + IPC_HEADER_SIZE,
+			client->len - IPC_HEADER_SIZE);
+		client->len -= IPC_HEADER_SIZE;
+
+		/* room for the terminator was kept by recv */
+		saved = client->buf[len];
+		client->buf[len] = '\0';
+		handle_message(client, type, client->buf);
+		client->buf[len] = saved;
+
+		client->len -= len;
+		memmove(client->buf, client->buf + len, client->len);
+	}
+
+	return true;
+}
+
+static int listen_socket(const char *path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket path too long\n");
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    listen(fd, MOCK_MAX_CLIENTS) < 0) {
+		fprintf(stderr, "Failed to listen on %s: %s\n", path,
+			strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-d usec] [-f bytes] [-o outputs] "
+		"[-w workspaces] [-v] socket\n"
+		"  -d  delay before each reply\n"
+		"  -f  filler bytes per workspace in GET_WORKSPACES replies\n"
+		"  -o  number of outputs workspaces are spread over\n"
+		"  -w  number of workspaces, 1 to N\n"
+		"  -v  print received messages\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	struct pollfd fds[MOCK_MAX_CLIENTS + 1];
+	int workspaces = 3;
+	int listen_fd, fd, opt, i;
+
+	mock.outputs = 1;
+
+	while ((opt = getopt(argc, argv, "d:f:o:w:vh")) != -1) {
+		switch (opt) {
+		case 'd':
+			mock.delay_usec = strtoul(optarg, NULL, 10);
+			break;
+		case 'f':
+			mock.filler = strtoul(optarg, NULL, 10);
+			break;
+		case 'o':
+			mock.outputs = atoi(optarg);
+			break;
+		case 'w':
+			workspaces = atoi(optarg);
+			break;
+		case 'v':
+			mock.verbose = true;
+			break;
+		case 'h':
+			usage(argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind != argc - 1 || mock.outputs < 1 || workspaces < 1 ||
+	    workspaces >= MOCK_MAX_WORKSPACES) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	for (i = 1; i <= workspaces; i++)
+		mock.exists[i] = true;
+	mock.focused = mock.previous = 1;
+
+	listen_fd = listen_socket(argv[optind]);
+	if (listen_fd < 0)
+		return EXIT_FAILURE;
+
+	signal(SIGPIPE, SIG_IGN);
+	fprintf(stderr, "SWAYSOCK=%s\n", argv[optind]);
+
+	for (;;) {
+		fds[0].fd = listen_fd;
+		fds[0].events = POLLIN;
+		for (i = 0; i < mock.nclients; i++) {
+			fds[i + 1].fd = mock.clients[i].fd;
+			fds[i + 1].events = POLLIN;
+		}
+
+		if (poll(fds, mock.nclients + 1, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		/* backwards, removal moves the last client */
+		for (i = mock.nclients - 1; i >= 0; i--)
+			if (fds[i + 1].revents &&
+			    !client_read(&mock.clients[i]))
+				client_remove(i);
+
+		if (fds[0].revents & POLLIN) {
+			fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+			if (fd < 0)
+				continue;
+			if (mock.nclients == MOCK_MAX_CLIENTS) {
+				close(fd);
+				continue;
+			}
+			memset(&mock.clients[mock.nclients], 0,
+			       sizeof(mock.clients[0]));
+			mock.clients[mock.nclients++].fd = fd;
+		}
+	}
+
+	close(listen_fd);
+	unlink(argv[optind]);
+	return EXIT_FAILURE;
+}
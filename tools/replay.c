@@ -0,0 +1,149 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "binding.h"
+#include "gesture.h"
+#include "latency.h"
+#include "log.h"
+#include "record.h"
+
+#include "fake-command.h"
+
+/* replayed events carry the time */
+static uint64_t replay_usec;
+
+static uint64_t replay_clock(void)
+{
+	return replay_usec;
+}
+
+static uint64_t clock_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void replay(const struct recording *recording)
+{
+	struct gesture *gestures[GESTURE_POOL_SIZE] = { NULL };
+	const struct gesture_event *event;
+	size_t i;
+
+	for (i = 0; i < recording->count; i++) {
+		event = &recording->events[i];
+		replay_usec = event->time_usec;
+		gesture_dispatch(&gestures[event->device % GESTURE_POOL_SIZE],
+				 event);
+		/* sway replies before the next event */
+		fake_command_complete();
+		log_flush();
+	}
+
+	/* recording stopped mid-gesture */
+	for (i = 0; i < GESTURE_POOL_SIZE; i++)
+		if (gestures[i])
+			gesture_destroy(gestures[i], NULL);
+	fake_command_complete();
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-c config] [-d] [-e] [-n loops] recording\n"
+		"  -c  bindings file, built-in defaults otherwise\n"
+		"  -d  debug logs\n"
+		"  -e  early commit: fire swipes as soon as the direction is clear\n"
+		"  -n  replay the recording loops times silently and time it\n"
+		"  -h  show this help\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	int ret = EXIT_FAILURE;
+	struct recording recording;
+	struct bindings *bindings;
+	const char *config = NULL;
+	unsigned long loops = 0, i;
+	uint64_t start_nsec, elapsed_nsec;
+	int opt;
+
+	openlog("swayped-replay", LOG_PERROR, LOG_USER);
+	log_set_level(LOG_ERR);
+
+	while ((opt = getopt(argc, argv, "c:den:h")) != -1) {
+		switch (opt) {
+		case 'c':
+			config = optarg;
+			break;
+		case 'd':
+			log_set_level(LOG_DEBUG);
+			break;
+		case 'e':
+			swipe_set_early_commit(true);
+			break;
+		case 'n':
+			loops = strtoul(optarg, NULL, 10);
+			break;
+		case 'h':
+			usage(argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	bindings = bindings_load(config);
+	if (!bindings)
+		goto exit;
+	bindings_set(bindings);
+	if (bindings->early_commit)
+		swipe_set_early_commit(true);
+
+	ret = recording_open(&recording, argv[optind]);
+	if (ret < 0) {
+		fprintf(stderr, "Failed to open %s: %s\n", argv[optind],
+			strerror(-ret));
+		ret = EXIT_FAILURE;
+		goto exit;
+	}
+
+	latency_set_clock(replay_clock);
+
+	/* actions of a single pass, one per line */
+	fake_command_set_output(stdout);
+	replay(&recording);
+
+	if (loops) {
+		fake_command_set_output(NULL);
+		start_nsec = clock_nsec();
+		for (i = 0; i < loops; i++)
+			replay(&recording);
+		elapsed_nsec = clock_nsec() - start_nsec;
+
+		fprintf(stderr, "%zu events x %lu: %.1f ns/event\n",
+			recording.count, loops,
+			recording.count ? (double)elapsed_nsec /
+					  (recording.count * loops) : 0.0);
+	}
+
+	recording_close(&recording);
+	ret = EXIT_SUCCESS;
+
+exit:
+	log_flush();
+	bindings_set(NULL);
+	bindings_destroy(bindings);
+	return ret;
+}